@@ -0,0 +1,326 @@
+/*
+文件发送策略 基准测试：文件大小 x 并发数 x 发送方式
+
+    每个发送线程通过一条本机 TCP 连接 向对应的接收线程发送同一个文件 (文件已在页缓存中)，输出每种组合的吞吐量 (MB/s)
+    1. read/cold  : 每次请求 pread 读入内存再 write (未缓存的读入方式)
+    2. read/hot   : 文件已读入内存，每次请求只 write (file_cache 中 IO_READ 条目的稳态)
+    3. mmap/cold  : 每次请求 mmap(MAP_POPULATE) + write + munmap
+    4. mmap/hot   : 文件已映射，每次请求只 write (file_cache 中 IO_MMAP 条目的稳态)
+    5. sendfile   : 每次请求 sendfile (fd 保持打开)
+    6. mmap/pipe  : 流水线，PIPE_DEPTH 个 (头部 + 已映射的文件) 合并为一次 writev (file_cache 中 IO_MMAP / IO_READ 条目的批量发送)
+    7. sf/pipe    : 流水线，PIPE_DEPTH 个 头部 send(MSG_MORE) + sendfile
+    最后一列为 io_strategy.h 默认阈值下 冷/热文件选择的发送方式，可据此调整 IO_READ_MAX / IO_MMAP_MAX
+
+    编译运行： make bench && ./bin/io_bench
+*/
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../io_strategy.h"
+
+#define BYTES_PER_RUN (128LL << 20)   // 每种组合 所有发送线程共发送的字节数
+#define MAX_THREADS 16                // 最大并发数
+#define DRAIN_BUF (256 << 10)         // 接收缓冲区大小
+#define PIPE_DEPTH 8                  // 流水线方式 一批的响应数
+#define HEAD_SIZE 200                 // 流水线方式 每个响应头部的大小
+
+// 测试的发送方式
+enum BENCH_MODE
+{
+    READ_COLD = 0,
+    READ_HOT,
+    MMAP_COLD,
+    MMAP_HOT,
+    SENDFILE,
+    MMAP_PIPE,
+    SENDFILE_PIPE,
+    MODE_COUNT
+};
+
+static const char *mode_names[MODE_COUNT] = {"read/cold", "read/hot", "mmap/cold", "mmap/hot",
+                                             "sendfile", "mmap/pipe", "sf/pipe"};
+
+struct sender_ctx
+{
+    int sock;               // 发送端 socket
+    int fd;                 // 文件 fd
+    long long size;         // 文件大小
+    int mode;               // 发送方式
+    long long requests;     // 请求数
+    pthread_barrier_t *bar; // 同时开始
+};
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void write_all(int sock, const char *buf, long long len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(sock, buf, len);
+        if (n <= 0)
+        {
+            perror("write");
+            exit(1);
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+// writev 全部数据，部分写入时 调整 iov 继续
+static void writev_all(int sock, struct iovec *iv, int count)
+{
+    while (count > 0)
+    {
+        ssize_t n = writev(sock, iv, count);
+        if (n <= 0)
+        {
+            perror("writev");
+            exit(1);
+        }
+        while (count > 0 && (size_t)n >= iv->iov_len)
+        {
+            n -= iv->iov_len;
+            ++iv;
+            --count;
+        }
+        if (count > 0)
+        {
+            iv->iov_base = (char *)iv->iov_base + n;
+            iv->iov_len -= n;
+        }
+    }
+}
+
+static void sendfile_all(int sock, int fd, long long size)
+{
+    off_t offset = 0;
+    while (offset < size)
+    {
+        if (sendfile(sock, fd, &offset, size - offset) <= 0)
+        {
+            perror("sendfile");
+            exit(1);
+        }
+    }
+}
+
+// 接收线程：读到对端关闭为止
+static void *drain(void *arg)
+{
+    int sock = (int)(long)arg;
+    char *buf = new char[DRAIN_BUF];
+    while (read(sock, buf, DRAIN_BUF) > 0)
+    {
+    }
+    delete[] buf;
+    close(sock);
+    return NULL;
+}
+
+// 发送线程：按发送方式 发送 requests 次文件
+static void *sender(void *arg)
+{
+    sender_ctx *ctx = (sender_ctx *)arg;
+    long long size = ctx->size;
+    char *buf = NULL;
+    char *addr = NULL;
+    if (ctx->mode == READ_COLD || ctx->mode == READ_HOT)
+    {
+        buf = new char[size];
+        if (ctx->mode == READ_HOT && pread(ctx->fd, buf, size, 0) != size)
+        {
+            perror("pread");
+            exit(1);
+        }
+    }
+    char head[HEAD_SIZE];
+    memset(head, 'h', sizeof(head));
+    struct iovec iv[2 * PIPE_DEPTH];
+    if (ctx->mode == MMAP_HOT || ctx->mode == MMAP_PIPE)
+    {
+        addr = (char *)mmap(0, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, ctx->fd, 0);
+    }
+
+    pthread_barrier_wait(ctx->bar);
+    long long step = (ctx->mode == MMAP_PIPE || ctx->mode == SENDFILE_PIPE) ? PIPE_DEPTH : 1;
+    for (long long i = 0; i < ctx->requests; i += step)
+    {
+        switch (ctx->mode)
+        {
+        case READ_COLD:
+            if (pread(ctx->fd, buf, size, 0) != size)
+            {
+                perror("pread");
+                exit(1);
+            }
+            write_all(ctx->sock, buf, size);
+            break;
+        case READ_HOT:
+            write_all(ctx->sock, buf, size);
+            break;
+        case MMAP_COLD:
+        {
+            char *p = (char *)mmap(0, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, ctx->fd, 0);
+            write_all(ctx->sock, p, size);
+            munmap(p, size);
+            break;
+        }
+        case MMAP_HOT:
+            write_all(ctx->sock, addr, size);
+            break;
+        case SENDFILE:
+            sendfile_all(ctx->sock, ctx->fd, size);
+            break;
+        case MMAP_PIPE:
+            for (int j = 0; j < PIPE_DEPTH; ++j)
+            {
+                iv[2 * j].iov_base = head;
+                iv[2 * j].iov_len = sizeof(head);
+                iv[2 * j + 1].iov_base = addr;
+                iv[2 * j + 1].iov_len = size;
+            }
+            writev_all(ctx->sock, iv, 2 * PIPE_DEPTH);
+            break;
+        default:
+            for (int j = 0; j < PIPE_DEPTH; ++j)
+            {
+                send(ctx->sock, head, sizeof(head), MSG_MORE);
+                sendfile_all(ctx->sock, ctx->fd, size);
+            }
+            break;
+        }
+    }
+    pthread_barrier_wait(ctx->bar);
+
+    if (addr)
+    {
+        munmap(addr, size);
+    }
+    delete[] buf;
+    return NULL;
+}
+
+// 建立 n 条本机 TCP 连接，发送端放入 socks，每条连接的接收端由一个接收线程读取
+static void connect_pairs(int n, int *socks, pthread_t *drains)
+{
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenfd, MAX_THREADS) != 0 ||
+        getsockname(listenfd, (struct sockaddr *)&addr, &len) != 0)
+    {
+        perror("listen");
+        exit(1);
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        socks[i] = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(socks[i], (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            perror("connect");
+            exit(1);
+        }
+        int peer = accept(listenfd, NULL, NULL);
+        pthread_create(drains + i, NULL, drain, (void *)(long)peer);
+    }
+    close(listenfd);
+}
+
+// 一种组合的吞吐量 (MB/s)
+static double run(int fd, long long size, int threads, int mode)
+{
+    int socks[MAX_THREADS];
+    pthread_t drains[MAX_THREADS], senders[MAX_THREADS];
+    sender_ctx ctx[MAX_THREADS];
+    pthread_barrier_t bar;
+    pthread_barrier_init(&bar, NULL, threads + 1);
+    connect_pairs(threads, socks, drains);
+
+    // 每个发送线程的请求数，流水线方式按整批发送
+    long long requests = BYTES_PER_RUN / size / threads;
+    requests = requests < PIPE_DEPTH ? PIPE_DEPTH : (requests + PIPE_DEPTH - 1) / PIPE_DEPTH * PIPE_DEPTH;
+    for (int i = 0; i < threads; ++i)
+    {
+        ctx[i].sock = socks[i];
+        ctx[i].fd = fd;
+        ctx[i].size = size;
+        ctx[i].mode = mode;
+        ctx[i].requests = requests;
+        ctx[i].bar = &bar;
+        pthread_create(senders + i, NULL, sender, ctx + i);
+    }
+    pthread_barrier_wait(&bar);
+    long long t0 = now_ns();
+    pthread_barrier_wait(&bar);
+    long long t1 = now_ns();
+
+    for (int i = 0; i < threads; ++i)
+    {
+        pthread_join(senders[i], NULL);
+        close(socks[i]);
+        pthread_join(drains[i], NULL);
+    }
+    pthread_barrier_destroy(&bar);
+    return (double)size * requests * threads / (1 << 20) / ((t1 - t0) / 1e9);
+}
+
+int main()
+{
+    long long sizes[] = {1 << 10, 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20};
+    int concurrency[] = {1, 4, 16};
+    io_thresholds t = {IO_READ_MAX, IO_MMAP_MAX, IO_HOT_HITS};
+
+    printf("%8s %4s", "size", "conc");
+    for (int m = 0; m < MODE_COUNT; ++m)
+    {
+        printf(" %10s", mode_names[m]);
+    }
+    printf("   auto (cold/hot)\n");
+
+    for (long long size : sizes)
+    {
+        char path[] = "/tmp/io_bench_XXXXXX";
+        int fd = mkstemp(path);
+        char *data = new char[size];
+        memset(data, 'x', size);
+        write_all(fd, data, size);
+        delete[] data;
+        unlink(path);
+
+        for (int threads : concurrency)
+        {
+            printf("%7lldK %4d", size >> 10, threads);
+            for (int m = 0; m < MODE_COUNT; ++m)
+            {
+                printf(" %10.0f", run(fd, size, threads, m));
+                fflush(stdout);
+            }
+            printf("   %s/%s\n", io_names[choose_io(IO_POLICY_AUTO, size, 0, t)],
+                   io_names[choose_io(IO_POLICY_AUTO, size, t.hot_hits, t)]);
+        }
+        close(fd);
+    }
+    printf("(MB/s)\n");
+    return 0;
+}
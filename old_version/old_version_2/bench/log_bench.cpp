@@ -0,0 +1,111 @@
+/*
+日志 基准测试：请求线程调用一次 LOG_INFO 的平均耗时
+
+    T 个线程同时各写 LINES 行 (格式与服务器中的常见日志相同)，输出 调用线程每次调用的平均 CPU 耗时 (ns，
+    不含被写日志线程抢占的时间) 与每秒行数 (含写日志线程的开销)。
+    日志写入 /tmp/log_bench/ 目录，测试结束后删除。
+    指定积压处理方式时 最多积压 OVERFLOW_PENDING 块缓冲区 (模拟写日志线程跟不上)，另外输出 丢弃的行数 与 等待的次数
+
+    编译运行： make bench && ./bin/log_bench [sync|text|deferred|binary] [write|drop_newest|drop_oldest|block|sample]
+              (默认测试异步文本模式，最多积压 64 块)
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../log.h"
+
+#define LINES 200000    // 每个线程写入的行数
+#define MAX_THREADS 8   // 最大线程数
+#define OVERFLOW_PENDING 2 // 指定积压处理方式时 最多积压的缓冲区数量
+
+static pthread_barrier_t s_bar;
+static long long s_dropped = 0; // 上一轮结束时 丢弃的行数
+static long long s_blocked = 0; // 上一轮结束时 等待的次数
+
+static long long now_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// 调用线程：写 LINES 行，返回本线程的 CPU 耗时 (纳秒)
+static void *writer(void *arg)
+{
+    long id = (long)arg;
+    pthread_barrier_wait(&s_bar);
+    long long t0 = now_ns(CLOCK_THREAD_CPUTIME_ID);
+    for (int i = 0; i < LINES; ++i)
+    {
+        LOG_INFO("client(%s:%d) GET /index.html %d, %lld bytes, loop %ld.", "127.0.0.1", 40000 + i % 20000,
+                 200, 1024LL + i, id);
+    }
+    return (void *)(now_ns(CLOCK_THREAD_CPUTIME_ID) - t0);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *name = argc > 1 ? argv[1] : "text";
+    int mode = LOG_TEXT;
+    if (strcmp(name, "deferred") == 0)
+    {
+        mode = LOG_DEFERRED;
+    }
+    else if (strcmp(name, "binary") == 0)
+    {
+        mode = LOG_BINARY;
+    }
+    const char *policies[] = {"write", "drop_newest", "drop_oldest", "block", "sample"}; // 与 LOG_OVERFLOW 顺序相同
+    const char *policy = argc > 2 ? argv[2] : NULL;
+    int overflow = LOG_DROP_NEWEST;
+    for (int i = 0; policy && i < 5; ++i)
+    {
+        if (strcmp(policy, policies[i]) == 0)
+        {
+            overflow = i;
+        }
+    }
+    int pending = strcmp(name, "sync") == 0 ? 0 : (policy ? OVERFLOW_PENDING : 64);
+    mkdir("/tmp/log_bench", 0755);
+    Log::getInstance()->init("/tmp/log_bench/bench.log", 0, 8192, 50000000, pending, mode);
+    Log::getInstance()->set_overflow(overflow);
+
+    int threads[] = {1, 2, 4, 8};
+    for (int n : threads)
+    {
+        pthread_t tids[MAX_THREADS];
+        pthread_barrier_init(&s_bar, NULL, n);
+        long long start = now_ns(CLOCK_MONOTONIC);
+        for (long i = 0; i < n; ++i)
+        {
+            pthread_create(tids + i, NULL, writer, (void *)i);
+        }
+        long long total = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            void *ret;
+            pthread_join(tids[i], &ret);
+            total += (long long)ret;
+        }
+        long long wall = now_ns(CLOCK_MONOTONIC) - start;
+        pthread_barrier_destroy(&s_bar);
+        long long dropped = Log::getInstance()->dropped();
+        long long blocked = Log::getInstance()->blocked();
+        printf("%-8s %d threads  %8.1f ns/call  %8.2f M lines/s", name, n, (double)total / n / LINES,
+               (double)n * LINES / wall * 1000);
+        if (policy)
+        {
+            printf("  %s dropped %lld blocked %lld", policy, dropped - s_dropped, blocked - s_blocked);
+        }
+        printf("\n");
+        s_dropped = dropped;
+        s_blocked = blocked;
+    }
+    system("rm -rf /tmp/log_bench");
+    return 0;
+}
@@ -0,0 +1,233 @@
+/*
+任务队列 基准测试：原 std::list + 互斥锁 + 信号量 对比 无锁环形队列 + futex 事件计数器
+
+    1. 吞吐量 : P 个生产者、C 个消费者 共传递 ITEMS 个任务，输出每秒 入队/出队 次数
+    2. 唤醒延迟 : 消费者空闲休眠时，从 入队 到 消费者取到任务 的平均耗时
+
+    编译运行： make bench && ./bin/queue_bench
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <list>
+#include <atomic>
+
+#include "../locker.h"
+#include "../ring_queue.h"
+
+#define ITEMS 2000000   // 吞吐量测试 传递的任务数
+#define WAKE_ROUNDS 200 // 唤醒延迟测试 轮数
+#define SPIN_COUNT 200  // 与 threadpool 相同的自旋次数
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// 原 threadpool 的队列实现
+class list_queue
+{
+public:
+    bool append(long *request)
+    {
+        m_locker.lock();
+        if (m_queue.size() >= 10000)
+        {
+            m_locker.unlock();
+            return false;
+        }
+        m_queue.push_back(request);
+        m_locker.unlock();
+        m_stat.post();
+        return true;
+    }
+
+    long *take()
+    {
+        while (true)
+        {
+            m_stat.wait();
+            m_locker.lock();
+            if (m_queue.empty())
+            {
+                m_locker.unlock();
+                continue;
+            }
+            long *request = m_queue.front();
+            m_queue.pop_front();
+            m_locker.unlock();
+            return request;
+        }
+    }
+
+private:
+    std::list<long *> m_queue;
+    locker m_locker;
+    sem m_stat;
+};
+
+// 新 threadpool 的队列实现
+class ring_event_queue
+{
+public:
+    ring_event_queue() : m_queue(10000) {}
+
+    bool append(long *request)
+    {
+        if (!m_queue.push(request))
+        {
+            return false;
+        }
+        m_stat.notify_one();
+        return true;
+    }
+
+    long *take()
+    {
+        long *request;
+        while (true)
+        {
+            for (int i = 0; i < SPIN_COUNT; ++i)
+            {
+                if (m_queue.pop(request))
+                {
+                    return request;
+                }
+            }
+            int key = m_stat.prepare_wait();
+            if (m_queue.pop(request))
+            {
+                m_stat.cancel_wait();
+                return request;
+            }
+            m_stat.wait(key);
+        }
+    }
+
+private:
+    ring_queue<long *> m_queue;
+    event_count m_stat;
+};
+
+template <typename Q>
+struct bench_ctx
+{
+    Q queue;
+    int producers;
+    int consumers;
+    std::atomic<long long> wake_total;
+    std::atomic<long long> stamp;
+};
+
+static long g_item = 1;   // 所有任务都指向同一个对象
+static long g_poison = 0; // 结束标记
+
+template <typename Q>
+static void *producer(void *arg)
+{
+    bench_ctx<Q> *ctx = (bench_ctx<Q> *)arg;
+    int n = ITEMS / ctx->producers;
+    for (int i = 0; i < n; ++i)
+    {
+        while (!ctx->queue.append(&g_item))
+        {
+            // 队列满，重试
+        }
+    }
+    return NULL;
+}
+
+template <typename Q>
+static void *consumer(void *arg)
+{
+    bench_ctx<Q> *ctx = (bench_ctx<Q> *)arg;
+    while (ctx->queue.take() != &g_poison)
+    {
+    }
+    return NULL;
+}
+
+template <typename Q>
+static void throughput(const char *name, int producers, int consumers)
+{
+    bench_ctx<Q> *ctx = new bench_ctx<Q>();
+    ctx->producers = producers;
+    ctx->consumers = consumers;
+    pthread_t p[16], c[16];
+
+    long long t0 = now_ns();
+    for (int i = 0; i < consumers; ++i)
+    {
+        pthread_create(c + i, NULL, consumer<Q>, ctx);
+    }
+    for (int i = 0; i < producers; ++i)
+    {
+        pthread_create(p + i, NULL, producer<Q>, ctx);
+    }
+    for (int i = 0; i < producers; ++i)
+    {
+        pthread_join(p[i], NULL);
+    }
+    for (int i = 0; i < consumers; ++i)
+    {
+        while (!ctx->queue.append(&g_poison))
+        {
+        }
+    }
+    for (int i = 0; i < consumers; ++i)
+    {
+        pthread_join(c[i], NULL);
+    }
+    long long t1 = now_ns();
+    printf("%-10s %dP/%dC  %8.2f M ops/s\n", name, producers, consumers,
+           (ITEMS / producers * producers) / ((t1 - t0) / 1000.0));
+    delete ctx;
+}
+
+template <typename Q>
+static void *wake_consumer(void *arg)
+{
+    bench_ctx<Q> *ctx = (bench_ctx<Q> *)arg;
+    while (ctx->queue.take() != &g_poison)
+    {
+        ctx->wake_total += now_ns() - ctx->stamp.load();
+    }
+    return NULL;
+}
+
+template <typename Q>
+static void wake_latency(const char *name)
+{
+    bench_ctx<Q> *ctx = new bench_ctx<Q>();
+    ctx->wake_total = 0;
+    pthread_t c;
+    pthread_create(&c, NULL, wake_consumer<Q>, ctx);
+    for (int i = 0; i < WAKE_ROUNDS; ++i)
+    {
+        usleep(2000); // 令消费者进入休眠
+        ctx->stamp = now_ns();
+        ctx->queue.append(&g_item);
+    }
+    usleep(2000);
+    ctx->queue.append(&g_poison);
+    pthread_join(c, NULL);
+    printf("%-10s wake-up latency %8.2f us\n", name, ctx->wake_total / (double)WAKE_ROUNDS / 1000.0);
+    delete ctx;
+}
+
+int main()
+{
+    int shapes[][2] = {{1, 1}, {1, 4}, {4, 4}, {4, 8}};
+    for (int i = 0; i < 4; ++i)
+    {
+        throughput<list_queue>("list+sem", shapes[i][0], shapes[i][1]);
+        throughput<ring_event_queue>("ring+futex", shapes[i][0], shapes[i][1]);
+    }
+    wake_latency<list_queue>("list+sem");
+    wake_latency<ring_event_queue>("ring+futex");
+    return 0;
+}
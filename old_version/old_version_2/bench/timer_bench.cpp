@@ -0,0 +1,98 @@
+/*
+定时器 基准测试：timer_list (升序链表) 对比 timer_wheel (哈希时间轮)
+
+    模拟 n 个 keep-alive 连接，先建立 n 个定时器，然后测量：
+    1. refresh : 每次读事件后将连接到期时间延后 (main 循环中 setTimer 的行为)
+    2. insert  : 新连接加入 (到期时间最晚)
+    3. cancel  : 连接关闭，删除定时器
+    每项操作执行 OPS 次，输出平均每次耗时 (ns)
+
+    编译运行： make bench && ./bin/timer_bench
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#include "../http_conn.h"
+
+#define OPS 10000 // 每项测量的操作次数
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void noop(http_conn *) {}
+
+template <typename TIMER>
+static void run(const char *name, int n)
+{
+    TIMER timers;
+    std::vector<ulist_timer *> nodes(n + OPS);
+    time_t base = ulist_timer::now_ms() + 5000;
+
+    // 按到期时间降序插入，使两种结构的 建立过程 都为 O(1)，只测量下面的典型操作
+    for (int i = 0; i < n; ++i)
+    {
+        nodes[i] = new ulist_timer();
+        nodes[i]->func = noop;
+        nodes[i]->expire = base - i;
+        timers.add_timer(nodes[i]);
+    }
+
+    // refresh : 随机连接收到请求，到期时间延后到 当前最晚
+    time_t latest = base;
+    srand(1);
+    long long t0 = now_ns();
+    for (int i = 0; i < OPS; ++i)
+    {
+        ulist_timer *t = nodes[rand() % n];
+        t->expire = ++latest;
+        timers.update_timer(t);
+    }
+    long long t1 = now_ns();
+
+    // insert : 新连接
+    for (int i = 0; i < OPS; ++i)
+    {
+        nodes[n + i] = new ulist_timer();
+        nodes[n + i]->func = noop;
+        nodes[n + i]->expire = ++latest;
+        timers.add_timer(nodes[n + i]);
+    }
+    long long t2 = now_ns();
+
+    // cancel : 连接关闭
+    for (int i = 0; i < OPS; ++i)
+    {
+        timers.del_timer(nodes[n + i]);
+    }
+    long long t3 = now_ns();
+
+    printf("%-12s n=%-7d refresh %10.1f ns/op   insert %10.1f ns/op   cancel %6.1f ns/op\n",
+           name, n, (t1 - t0) / (double)OPS, (t2 - t1) / (double)OPS, (t3 - t2) / (double)OPS);
+
+    for (int i = 0; i < n; ++i)
+    {
+        timers.del_timer(nodes[i]);
+    }
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        delete nodes[i];
+    }
+}
+
+int main()
+{
+    int sizes[] = {1000, 10000, 100000};
+    for (int i = 0; i < 3; ++i)
+    {
+        run<timer_list>("timer_list", sizes[i]);
+        run<timer_wheel>("timer_wheel", sizes[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "buffer_pool.h"
+
+// 按级别创建空闲块队列，级别越大 缓存的块越少
+buffer_pool::buffer_pool() : m_in_use(0)
+{
+    for (int i = 0; i < BUFFER_CLASS_SIZE; ++i)
+    {
+        m_free[i] = new ring_queue<char *>(BUFFER_CACHE_BYTES >> (BUFFER_MIN_SHIFT + i));
+    }
+}
+
+// 释放所有缓存的空闲块
+buffer_pool::~buffer_pool()
+{
+    for (int i = 0; i < BUFFER_CLASS_SIZE; ++i)
+    {
+        char *buf;
+        while (m_free[i]->pop(buf))
+        {
+            delete[] buf;
+        }
+        delete m_free[i];
+    }
+}
+
+// size 所属的级别
+int buffer_pool::size_class(size_t size)
+{
+    int cls = 0;
+    while (cls < BUFFER_CLASS_SIZE && ((size_t)1 << (BUFFER_MIN_SHIFT + cls)) < size)
+    {
+        ++cls;
+    }
+    return cls;
+}
+
+// 申请缓冲区。优先复用空闲块
+char *buffer_pool::acquire(size_t size, int *capacity)
+{
+    int cls = size_class(size);
+    if (cls >= BUFFER_CLASS_SIZE)
+    {
+        return NULL; // 超过最大块大小
+    }
+    *capacity = 1 << (BUFFER_MIN_SHIFT + cls);
+    m_in_use.fetch_add(*capacity, std::memory_order_relaxed);
+
+    char *buf;
+    if (m_free[cls]->pop(buf))
+    {
+        return buf;
+    }
+    return new char[*capacity];
+}
+
+// 归还缓冲区。缓存已满则直接释放
+void buffer_pool::release(char *buf, int capacity)
+{
+    if (buf == NULL)
+    {
+        return;
+    }
+    m_in_use.fetch_sub(capacity, std::memory_order_relaxed);
+    int cls = size_class(capacity);
+    if (!m_free[cls]->push(buf))
+    {
+        delete[] buf;
+    }
+}
+
+// 当前被借出的缓冲区总字节数
+long long buffer_pool::in_use() const
+{
+    return m_in_use.load(std::memory_order_relaxed);
+}
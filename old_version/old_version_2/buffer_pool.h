@@ -0,0 +1,54 @@
+/*
+缓冲区池类：
+
+    采用 单例模式 (懒汉模式)，所有事件循环与工作线程共享
+    1. 按大小分级 (1K, 2K, 4K ... 64K)，申请时向上取整到所属级别
+    2. 每个级别用 无锁环形队列 ring_queue 保存空闲块，归还的块优先复用，超过缓存上限则直接释放
+    3. http 连接只在 有请求数据/正在响应 时持有缓冲区，空闲连接不占用缓冲区内存
+*/
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+#include <atomic>
+
+#include "ring_queue.h"
+
+#define BUFFER_MIN_SHIFT 10                  // 最小级别 1K
+#define BUFFER_CLASS_SIZE 7                  // 级别数量：1K ~ 64K
+#define BUFFER_MAX_SIZE (1 << (BUFFER_MIN_SHIFT + BUFFER_CLASS_SIZE - 1)) // 最大块大小 64K
+#define BUFFER_CACHE_BYTES (4 << 20)         // 每个级别 最多缓存的空闲内存 (字节)
+
+class buffer_pool
+{
+public:
+    // C++11 之后，使用局部静态变量 懒汉模式 无需加锁处理
+    static buffer_pool *getInstance()
+    {
+        static buffer_pool instance;
+        return &instance;
+    }
+
+    // 申请不小于 size 字节的缓冲区，实际容量写入 capacity。size 超过 BUFFER_MAX_SIZE 返回 NULL
+    char *acquire(size_t size, int *capacity);
+
+    // 归还 acquire 得到的缓冲区，capacity 为其实际容量
+    void release(char *buf, int capacity);
+
+    // 当前被借出的缓冲区总字节数
+    long long in_use() const;
+
+private:
+    buffer_pool();
+    ~buffer_pool();
+
+    // size 所属的级别
+    static int size_class(size_t size);
+
+private:
+    ring_queue<char *> *m_free[BUFFER_CLASS_SIZE]; // 各级别的空闲块
+    std::atomic<long long> m_in_use;               // 被借出的总字节数
+};
+
+#endif
@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "compress_cache.h"
+#include "log.h"
+#include "overload.h"
+
+compress_cache::compress_cache() : m_max_bytes(COMPRESS_CACHE_BYTES / COMPRESS_CACHE_SHARDS),
+                                   m_min_size(COMPRESS_MIN_SIZE), m_max_size(COMPRESS_MAX_SIZE),
+                                   m_ttl_ms(FILE_CACHE_TTL_MS), m_next_id(0), m_hits(0), m_misses(0),
+                                   m_compressed(0), m_bytes_in(0), m_bytes_out(0), m_reported(0)
+{
+    m_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (m_cpus <= 0)
+    {
+        m_cpus = 1;
+    }
+    for (int i = 0; i < COMPRESS_CACHE_SHARDS; ++i)
+    {
+        m_shards[i].bytes = 0;
+        m_shards[i].generation = 0;
+    }
+}
+
+// 释放缓存持有的引用
+compress_cache::~compress_cache()
+{
+    clear();
+}
+
+// 设置缓存限制。在工作线程启动之前调用
+void compress_cache::init(long long max_bytes, int min_size, int max_size, int ttl_ms)
+{
+    m_max_bytes = (max_bytes + COMPRESS_CACHE_SHARDS - 1) / COMPRESS_CACHE_SHARDS;
+    m_min_size = min_size;
+    m_max_size = max_size;
+    m_ttl_ms = ttl_ms;
+}
+
+// 单调时钟 (毫秒)
+time_t compress_cache::now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 按路径哈希选择分片。同一路径的各编码在同一分片，便于一起失效
+compress_cache::shard &compress_cache::get_shard(std::string_view path)
+{
+    return m_shards[std::hash<std::string_view>()(path) % COMPRESS_CACHE_SHARDS];
+}
+
+// 按每个 CPU 的 1 分钟平均负载选择压缩级别。线程池排队时延超标时 不压缩
+int compress_cache::choose_level()
+{
+    if (overload::getInstance()->dropping())
+    {
+        return 0;
+    }
+    double load;
+    if (getloadavg(&load, 1) != 1)
+    {
+        return COMPRESS_LEVEL_MID;
+    }
+    load /= m_cpus;
+    if (load < 0.5)
+    {
+        return COMPRESS_LEVEL_HIGH;
+    }
+    return load < 1.0 ? COMPRESS_LEVEL_MID : COMPRESS_LEVEL_LOW;
+}
+
+// gzip 压缩 src 到 out (容量至少为 deflateBound)，成功返回真
+static bool gzip_compress(const char *src, size_t len, int level, char *out, size_t out_size, size_t *out_len)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 15 + 16 : 输出 gzip 格式 (带 gzip 头部与 CRC)
+    if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+    zs.next_in = (Bytef *)src;
+    zs.avail_in = len;
+    zs.next_out = (Bytef *)out;
+    zs.avail_out = out_size;
+    int ret = deflate(&zs, Z_FINISH);
+    *out_len = zs.total_out;
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+// 查询压缩结果。过期的节点直接移除，正在压缩的文件 本次按不压缩处理
+COMPRESS_RESULT compress_cache::acquire(const char *path, int encoding, cached_response **resp)
+{
+    if (!enabled())
+    {
+        return COMPRESS_MISS;
+    }
+    std::string_view key(path);
+    shard &s = get_shard(key);
+    time_t now = now_ms();
+    COMPRESS_RESULT result = COMPRESS_MISS;
+    std::list<cached_response *> victims;
+
+    s.lock.lock();
+    auto it = s.map[encoding].find(key);
+    if (it != s.map[encoding].end())
+    {
+        node &n = *it->second;
+        if (now >= n.expire)
+        {
+            erase(s, it->second, victims);
+        }
+        else if (n.state == NODE_READY)
+        {
+            s.lru.splice(s.lru.begin(), s.lru, it->second); // 移到 LRU 表头
+            n.resp->refs.fetch_add(1, std::memory_order_relaxed);
+            *resp = n.resp;
+            result = COMPRESS_HIT;
+        }
+        else
+        {
+            result = COMPRESS_SKIP; // 不值得压缩 或 其他线程正在压缩
+        }
+    }
+    s.lock.unlock();
+
+    for (cached_response *v : victims)
+    {
+        response_cache::release(v);
+    }
+    if (result == COMPRESS_HIT)
+    {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+    }
+    else if (result == COMPRESS_MISS)
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+// 压缩并缓存。先在锁内登记 "正在压缩"，在锁外读取并压缩，最后确认节点仍是本次登记的节点、
+// 且期间分片未发生过失效后 写入结果
+cached_response *compress_cache::compress(const file_entry *file, int encoding)
+{
+    size_t size = file->st.st_size;
+    if (!enabled() || !(COMPRESS_ENCODINGS & (1u << encoding)) || !file->compressible || file->encoding >= 0 ||
+        size < (size_t)m_min_size || size > (size_t)m_max_size)
+    {
+        return NULL;
+    }
+    int level = choose_level();
+    if (level == 0)
+    {
+        return NULL; // 过载，暂不压缩
+    }
+
+    shard &s = get_shard(file->path);
+    unsigned long id = m_next_id.fetch_add(1, std::memory_order_relaxed);
+    std::list<cached_response *> victims;
+    s.lock.lock();
+    auto it = s.map[encoding].find(file->path);
+    if (it != s.map[encoding].end())
+    {
+        s.lock.unlock();
+        return NULL; // 其他线程已登记
+    }
+    node n;
+    n.path = file->path;
+    n.encoding = encoding;
+    n.state = NODE_PENDING;
+    n.id = id;
+    n.resp = NULL;
+    n.expire = now_ms() + m_ttl_ms;
+    s.lru.push_front(n);
+    s.map[encoding][s.lru.front().path] = s.lru.begin();
+    unsigned generation = s.generation;
+    s.lock.unlock();
+
+    // 读取并压缩。文件在内存中时直接压缩。登记之前文件可能已被修改 (此时的失效不会反映在代数上)，先重新校验
+    char *src = NULL;
+    char *buf = NULL;
+    if (file_cache::unchanged(file->path.c_str(), file))
+    {
+        src = file->addr.load(std::memory_order_acquire);
+        if (src == NULL)
+        {
+            buf = new char[size];
+            src = file_cache::read(file, buf) ? buf : NULL;
+        }
+    }
+    cached_response *resp = NULL;
+    bool truncated = src == NULL;
+    if (src != NULL)
+    {
+        size_t bound = deflateBound(NULL, size) + 32; // gzip 头部与尾部
+        char *out = new char[bound];
+        size_t out_len = 0;
+        if (gzip_compress(src, size, level, out, bound, &out_len))
+        {
+            m_compressed.fetch_add(1, std::memory_order_relaxed);
+            m_bytes_in.fetch_add(size, std::memory_order_relaxed);
+            m_bytes_out.fetch_add(out_len, std::memory_order_relaxed);
+        }
+        else
+        {
+            out_len = size; // 压缩失败，按不值得压缩处理
+        }
+
+        // 压缩后至少减少 COMPRESS_MIN_SAVING%，才生成响应。压缩结果的 ETag 为弱标签：不同压缩级别的输出不同
+        if (out_len * 100 <= size * (100 - COMPRESS_MIN_SAVING))
+        {
+            char etag[ETAG_SIZE];
+            char header[FILE_HEADER_SIZE];
+            snprintf(etag, sizeof(etag), "W/\"%.*s-%s\"", (int)strlen(file->etag) - 2, file->etag + 1,
+                     encoding_names[encoding]);
+            int header_len = snprintf(header, sizeof(header),
+                                      "%s %d %s\r\nContent-Length: %lld\r\nContent-Type:%s\r\nContent-Encoding: %s\r\n"
+                                      "Vary: Accept-Encoding\r\nLast-Modified: %s\r\nETag: %s\r\n",
+                                      "HTTP/1.1", 200, "OK", (long long)out_len, file->content_type,
+                                      encoding_names[encoding], file->last_modified, etag);
+            if (header_len < (int)sizeof(header))
+            {
+                resp = response_cache::create(file, header, header_len, out_len);
+            }
+            if (resp != NULL)
+            {
+                memcpy(resp->data + resp->head_len, out, out_len);
+                memcpy(resp->etag, etag, sizeof(etag));
+                resp->encodings = 1u << encoding; // 304 响应同样需要 Vary
+            }
+        }
+        delete[] out;
+    }
+    delete[] buf;
+
+    // 写入结果。节点已被失效/淘汰/替换时 结果只供本次请求使用
+    s.lock.lock();
+    it = s.map[encoding].find(file->path);
+    if (it != s.map[encoding].end() && it->second->id == id)
+    {
+        node &cur = *it->second;
+        if (truncated || s.generation != generation)
+        {
+            erase(s, it->second, victims); // 文件已变化或在读取过程中被截断，下次重新压缩
+        }
+        else if (resp != NULL)
+        {
+            cur.state = NODE_READY;
+            cur.resp = resp;
+            resp->refs.fetch_add(1, std::memory_order_relaxed); // 缓存持有一个引用
+            s.bytes += resp->len;
+            while (s.bytes > m_max_bytes && s.lru.size() > 1)
+            {
+                erase(s, std::prev(s.lru.end()), victims);
+            }
+        }
+        else
+        {
+            cur.state = NODE_SKIP;
+        }
+    }
+    s.lock.unlock();
+
+    for (cached_response *v : victims)
+    {
+        response_cache::release(v);
+    }
+    return resp;
+}
+
+// 从分片中移除节点 (需持有分片锁)
+void compress_cache::erase(shard &s, std::list<node>::iterator it, std::list<cached_response *> &victims)
+{
+    if (it->resp != NULL)
+    {
+        s.bytes -= it->resp->len;
+        victims.push_back(it->resp);
+    }
+    s.map[it->encoding].erase(std::string_view(it->path));
+    s.lru.erase(it);
+}
+
+// 使 path 的所有压缩结果失效。正在发送的响应仍持有引用，发送完毕后才真正释放
+void compress_cache::invalidate(const char *path)
+{
+    std::string_view key(path);
+    shard &s = get_shard(key);
+    std::list<cached_response *> victims;
+
+    s.lock.lock();
+    ++s.generation;
+    for (int i = 0; i < ENC_COUNT; ++i)
+    {
+        auto it = s.map[i].find(key);
+        if (it != s.map[i].end())
+        {
+            erase(s, it->second, victims);
+        }
+    }
+    s.lock.unlock();
+
+    for (cached_response *v : victims)
+    {
+        response_cache::release(v);
+    }
+}
+
+// 使所有压缩结果失效
+void compress_cache::clear()
+{
+    for (int i = 0; i < COMPRESS_CACHE_SHARDS; ++i)
+    {
+        shard &s = m_shards[i];
+        std::list<cached_response *> victims;
+        s.lock.lock();
+        while (!s.lru.empty())
+        {
+            erase(s, s.lru.begin(), victims);
+        }
+        ++s.generation;
+        s.lock.unlock();
+
+        for (cached_response *v : victims)
+        {
+            response_cache::release(v);
+        }
+    }
+}
+
+// 统计有变化时 写入日志
+void compress_cache::report()
+{
+    long long hits = m_hits.load(std::memory_order_relaxed);
+    long long misses = m_misses.load(std::memory_order_relaxed);
+    if (hits + misses == m_reported)
+    {
+        return;
+    }
+    m_reported = hits + misses;
+    long long in = m_bytes_in.load(std::memory_order_relaxed);
+    long long out = m_bytes_out.load(std::memory_order_relaxed);
+    LOG_INFO("compress cache: hits=%lld, misses=%lld, compressed=%lld, ratio=%.1f%%.", hits, misses,
+             m_compressed.load(std::memory_order_relaxed), in ? 100.0 * out / in : 0.0);
+}
@@ -0,0 +1,139 @@
+/*
+动态压缩缓存类：
+
+    采用 单例模式 (懒汉模式)，所有工作线程共享
+    1. 没有预压缩文件的文本类文件 (按 MIME 表的可压缩标记，不压缩 JPEG/MP4 等)，大小在 [min_size, max_size] 之间时，
+       第一次被接受 gzip 的客户端请求时 用 zlib 压缩一次，压缩结果以 (路径, 编码) 为键缓存，并记录源文件的修改时间
+    2. 压缩结果保存为 不可变的完整响应 (cached_response，带 Content-Encoding、Vary、弱 ETag)，
+       与完整响应缓存走同一条发送路径；压缩收益不足的文件 记录为 "不压缩"，之后直接发送原文件
+    3. 压缩级别随 CPU 负载调整：负载低时用高压缩级别 (只压缩一次，值得多花 CPU)，负载高时降低级别，
+       线程池排队时延超标 (过载丢弃状态) 时 暂不压缩
+    4. 同一文件同时只有一个线程在压缩，其他请求先发送原文件；条目超过 TTL 或被文件监听线程失效后重新压缩
+    5. 范围请求不压缩 (按原文件发送)
+*/
+
+#ifndef COMPRESS_CACHE_H
+#define COMPRESS_CACHE_H
+
+#include <stddef.h>
+#include <time.h>
+#include <atomic>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "file_cache.h"
+#include "http_encoding.h"
+#include "locker.h"
+#include "response_cache.h"
+
+#define COMPRESS_CACHE_SHARDS 16            // 分片数量
+#define COMPRESS_CACHE_BYTES (32LL << 20)   // 默认 压缩结果的内存预算
+#define COMPRESS_MIN_SIZE 256               // 默认 小于该大小的文件不压缩
+#define COMPRESS_MAX_SIZE (1 << 20)         // 默认 大于该大小的文件不压缩 (避免单个请求长时间占用工作线程)
+#define COMPRESS_MIN_SAVING 10              // 压缩后至少减少的百分比，否则记录为不压缩
+#define COMPRESS_LEVEL_HIGH 9               // CPU 空闲时的压缩级别
+#define COMPRESS_LEVEL_MID 6                // CPU 负载中等时的压缩级别
+#define COMPRESS_LEVEL_LOW 1                // CPU 繁忙时的压缩级别
+#define COMPRESS_ENCODINGS (1u << ENC_GZIP) // 支持动态压缩的编码 (按 CONTENT_ENCODING 的位掩码)
+
+// 查询结果
+enum COMPRESS_RESULT
+{
+    COMPRESS_MISS = 0, // 没有压缩结果
+    COMPRESS_HIT,      // 命中压缩结果
+    COMPRESS_SKIP      // 已知该文件不值得压缩
+};
+
+class compress_cache
+{
+public:
+    // C++11 之后，使用局部静态变量 懒汉模式 无需加锁处理
+    static compress_cache *getInstance()
+    {
+        static compress_cache instance;
+        return &instance;
+    }
+
+    // 设置 内存预算、压缩的文件大小范围、过期时间。max_bytes 为 0 表示关闭动态压缩
+    void init(long long max_bytes, int min_size, int max_size, int ttl_ms);
+
+    // 是否开启动态压缩
+    bool enabled() const { return m_max_bytes > 0; }
+
+    // 查询 path 以 encoding 压缩的结果。命中时通过 resp 传出 已加一引用的完整响应 (用完需 response_cache::release)
+    COMPRESS_RESULT acquire(const char *path, int encoding, cached_response **resp);
+
+    // 压缩 file 并缓存。返回已加一引用的完整响应，不压缩 (类型、大小、收益、负载、其他线程正在压缩) 时返回 NULL
+    cached_response *compress(const file_entry *file, int encoding);
+
+    // 使 path 的所有压缩结果失效
+    void invalidate(const char *path);
+
+    // 使所有压缩结果失效
+    void clear();
+
+    // 统计有变化时 写入日志
+    void report();
+
+private:
+    compress_cache();
+    ~compress_cache();
+
+    // 节点状态
+    enum NODE_STATE
+    {
+        NODE_PENDING = 0, // 正在压缩
+        NODE_READY,       // 已压缩
+        NODE_SKIP         // 不值得压缩
+    };
+
+    // 一个压缩结果
+    struct node
+    {
+        std::string path;      // 文件完整路径
+        int encoding;          // 编码
+        NODE_STATE state;      // 状态
+        unsigned long id;      // 创建序号，压缩完成后用于确认节点未被替换
+        cached_response *resp; // 压缩后的完整响应 (持有一个引用)，只有 NODE_READY 有
+        time_t expire;         // 过期时间
+    };
+
+    // 分片：互斥锁 + 每种编码一个哈希表 + LRU 链表 (表头为最近使用)
+    struct shard
+    {
+        locker lock;
+        std::unordered_map<std::string_view, std::list<node>::iterator> map[ENC_COUNT];
+        std::list<node> lru;
+        long long bytes;      // 本分片压缩结果的总字节数
+        unsigned generation;  // 失效代数：invalidate / clear 时递增
+    };
+
+    shard &get_shard(std::string_view path);
+    static time_t now_ms();
+
+    // 按当前 CPU 负载选择压缩级别，过载时返回 0 (不压缩)
+    int choose_level();
+
+    // 从分片中移除节点，被移除的完整响应放入 victims 由调用者在锁外释放 (需持有分片锁)
+    void erase(shard &s, std::list<node>::iterator it, std::list<cached_response *> &victims);
+
+private:
+    shard m_shards[COMPRESS_CACHE_SHARDS]; // 分片
+    long long m_max_bytes;                 // 每个分片的内存预算
+    int m_min_size;                        // 压缩的最小文件
+    int m_max_size;                        // 压缩的最大文件
+    int m_ttl_ms;                          // 条目有效时间
+    int m_cpus;                            // CPU 数量
+    std::atomic<unsigned long> m_next_id;  // 节点创建序号
+
+    std::atomic<long long> m_hits;      // 命中次数
+    std::atomic<long long> m_misses;    // 未命中次数
+    std::atomic<long long> m_compressed; // 压缩次数
+    std::atomic<long long> m_bytes_in;  // 压缩前 总字节数
+    std::atomic<long long> m_bytes_out; // 压缩后 总字节数
+    long long m_reported;               // 上次写入日志时的 总查询次数
+};
+
+#endif
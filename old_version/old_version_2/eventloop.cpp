@@ -0,0 +1,357 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <exception>
+
+#include "eventloop.h"
+#include "file_cache.h"
+#include "response_cache.h"
+#include "compress_cache.h"
+#include "io_reader.h"
+#include "log.h"
+#include "overload.h"
+
+// 向 epfd 添加需要监听的 fd
+extern void addfd(int epfd, int fd, bool one_shot);
+// 设置 fd 非阻塞
+extern int setnonblocking(int fd);
+
+extern void back_func(http_conn *user_data);
+
+// 类静态变量成员 初始化
+int eventloop::s_sig_pipefd[MAX_LOOP] = {0};
+int eventloop::s_loop_size = 0;
+
+// 创建本循环的 epoll 对象、信号管道、timerfd、监听socket
+eventloop::eventloop(int id, int port, http_conn *users, threadpool<http_conn> *pool)
+    : m_id(id), m_epfd(-1), m_listenfd(-1), m_timerfd(-1), m_timer_wheel(NULL), m_users(users),
+      m_pool(pool), m_events(NULL), m_thread(0), m_stop(false), m_timeout(false), m_last_report(0)
+{
+    if (s_loop_size >= MAX_LOOP)
+    {
+        throw std::exception(); // 超过最大事件循环数量
+    }
+
+    // 创建管道
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, m_pipefd) == -1)
+    {
+        throw std::exception();
+    }
+
+    // 创建监听socket
+    m_listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listenfd < 0)
+    {
+        throw std::exception();
+    }
+
+    // 绑定监听socket
+    struct sockaddr_in saddr;
+    memset(&saddr, 0, sizeof(saddr));
+    saddr.sin_addr.s_addr = INADDR_ANY; // 接受 IP 类型
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = htons(port);
+
+    // 设置端口复用(绑定之前进行设置复用)。SO_REUSEPORT 令每个循环都能绑定同一端口，由内核做负载均衡
+    int reuse = 1; // 1 表示端口复用
+    if (setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1 ||
+        setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == -1)
+    {
+        throw std::exception();
+    }
+    if (bind(m_listenfd, (struct sockaddr *)&saddr, sizeof(saddr)) == -1)
+    {
+        throw std::exception();
+    }
+
+    // 监听
+    if (listen(m_listenfd, 8) == -1)
+    {
+        throw std::exception();
+    }
+
+    // 创建 epoll 对象，事件数组
+    m_epfd = epoll_create(100);
+    if (m_epfd == -1)
+    {
+        throw std::exception();
+    }
+    m_events = new epoll_event[MAX_EVENT_NUMBER];
+    m_timer_wheel = new timer_wheel();
+
+    // 创建 timerfd，按时间轮刻度周期触发，代替 SIGALRM 信号
+    m_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_timerfd == -1)
+    {
+        throw std::exception();
+    }
+    struct itimerspec its;
+    its.it_interval.tv_sec = TIMER_TICK_MS / 1000;
+    its.it_interval.tv_nsec = (TIMER_TICK_MS % 1000) * 1000000;
+    its.it_value = its.it_interval;
+    if (timerfd_settime(m_timerfd, 0, &its, NULL) == -1)
+    {
+        throw std::exception();
+    }
+    addfd(m_epfd, m_timerfd, false);
+
+    // 将 监听fd 添加到 epfd
+    addfd(m_epfd, m_listenfd, false); // false 表示 不开启oneshot，会持续通知
+
+    // 将 管道fd 添加到 epfd
+    addfd(m_epfd, m_pipefd[0], false);
+    setnonblocking(m_pipefd[1]); // 设置写端非阻塞
+
+    // 注册管道写端，供信号处理函数广播
+    s_sig_pipefd[s_loop_size++] = m_pipefd[1];
+}
+
+eventloop::~eventloop()
+{
+    close(m_epfd);     // 关闭 epoll
+    close(m_listenfd); // 关闭 监听fd
+    close(m_timerfd);  // 关闭 timerfd
+    delete[] m_events;
+    delete m_timer_wheel;
+}
+
+// 信号处理函数。 将信号 转化为 char* 发送到每个循环的 pipefd[1] （管道写端）
+void eventloop::sig_handler(int sig)
+{
+    int save_errno = errno;
+    int msg = sig;
+    for (int i = 0; i < s_loop_size; ++i)
+    {
+        send(s_sig_pipefd[i], (char *)&msg, 1, 0);
+    }
+    errno = save_errno;
+}
+
+// 线程入口函数
+void *eventloop::worker(void *arg)
+{
+    eventloop *el = (eventloop *)arg;
+    el->loop();
+    return el;
+}
+
+// 在新线程中运行 loop()
+bool eventloop::start()
+{
+    return pthread_create(&m_thread, NULL, worker, this) == 0;
+}
+
+// 等待 start() 创建的线程结束
+void eventloop::join()
+{
+    if (m_thread)
+    {
+        pthread_join(m_thread, NULL);
+    }
+}
+
+// 处理新连接
+void eventloop::handle_accept()
+{
+    struct sockaddr_in client_address;
+    socklen_t client_addrlen = sizeof(client_address);
+    int connfd = accept(m_listenfd, (struct sockaddr *)&client_address, &client_addrlen);
+
+    if (connfd < 0)
+    {
+        return;
+    }
+
+    // 目前连接请求数 超过 最大文件描述符个数
+    if (http_conn::m_user_size >= MAX_FD || connfd >= MAX_FD)
+    {
+        // 给客户端回传一个信息：服务器内部正忙
+        printf("服务器正忙, 断开当前链接。\n");
+        overload::getInstance()->reject(connfd, SHED_CONN_LIMIT);
+        close(connfd); // 关闭当前链接  (分配的连接进行关闭)
+        return;        // 继续监听
+    }
+
+    // 当前客户端 ip
+    char ip[16] = {0};
+    inet_ntop(AF_INET, &client_address.sin_addr.s_addr, ip, sizeof(ip));
+    unsigned short ppport = ntohs(client_address.sin_port);
+    printf("loop %d 当前客户端ip:%s,端口：%d, 分配的通信fd:%d\n", m_id, ip, ppport, connfd);
+    LOG_INFO("client(%s:%d) is connected.", ip, ppport);
+
+    // 将新的客户连接进行初始化， 并放入用户数据信息。连接归属于本循环
+    m_users[connfd].init(connfd, client_address, m_epfd, m_timer_wheel);
+
+    // 创建新 http 定时器
+    m_users[connfd].setTimer(m_users + connfd, back_func, TIMESLOTS);
+}
+
+// 处理读事件。读取完毕后将任务加入线程池
+void eventloop::handle_read(http_conn *user)
+{
+    // 读事件就绪, 调用read()读取数据到读缓冲
+    if (!user->read())
+    {
+        user->m_timer->func(user); // 读事件处理失败，关闭 用户请求任务
+        return;
+    }
+    dispatch(user);
+}
+
+// 将连接交给线程池处理读缓冲中的请求，过载时直接回复 503 并关闭连接
+void eventloop::dispatch(http_conn *user)
+{
+    // 排队时延过高 或者 请求队列已满，不再进入线程池，由事件循环直接拒绝
+    time_t now = m_timer_wheel->now(); // 本轮 epoll_wait 缓存的时间，只用于准入判断
+    overload *ctl = overload::getInstance();
+    SHED_REASON reason = SHED_CODEL;
+    bool admitted = ctl->admit(now);
+    if (admitted)
+    {
+        // 入队时间取实时时钟：缓存时间 会把本轮之前事件的处理时间 计入排队时延
+        user->m_queue_time = ulist_timer::now_ms();
+        admitted = m_pool->append(user, user->m_sockfd); // 加入线程请求任务队列 (按 fd 分发)
+        reason = SHED_QUEUE_FULL;
+    }
+    if (!admitted)
+    {
+        ctl->reject(user->m_sockfd, reason);
+        user->m_timer->func(user);
+        return;
+    }
+
+    // 更新当前 http 任务的定时器
+    if (user->m_timer != nullptr)
+    {
+        user->setTimer(user, back_func, TIMESLOTS); // 调整 http 任务的 时间节点信息
+    }
+}
+
+// 处理管道中的信号
+void eventloop::handle_signal()
+{
+    char signals[1024];
+    int ret = recv(m_pipefd[0], signals, sizeof(signals), 0);
+    if (ret <= 0)
+    {
+        return;
+    }
+
+    // 接收到信号 进行逻辑处理
+    for (int i = 0; i < ret; ++i)
+    {
+        switch (signals[i])
+        {
+        case SIGTERM:
+        {
+            m_stop = true;
+            break;
+        }
+        }
+    }
+}
+
+// 处理 timerfd 到期通知。读出到期次数，清除可读状态
+void eventloop::handle_timerfd()
+{
+    uint64_t expirations;
+    if (::read(m_timerfd, &expirations, sizeof(expirations)) == sizeof(expirations))
+    {
+        m_timeout = true;
+    }
+}
+
+// 定时标记 处理函数
+void eventloop::timer_handler()
+{
+    // 定时处理任务，实际上就是调用tick()函数
+    m_timer_wheel->tick();
+
+    // 第 0 个事件循环 定期写入过载与缓存统计
+    time_t now = m_timer_wheel->now();
+    if (m_id == 0 && now - m_last_report >= REPORT_MS)
+    {
+        overload::getInstance()->report();
+        file_cache::getInstance()->report();
+        response_cache::getInstance()->report();
+        compress_cache::getInstance()->report();
+        io_reader::getInstance()->report();
+        Log::getInstance()->report();
+        m_last_report = now;
+    }
+}
+
+// 循环检测 epoll 事件
+void eventloop::loop()
+{
+    LOG_INFO("eventloop %d is listening.", m_id);
+    while (!m_stop)
+    {
+        // epoll_wait 的第二个参数为传出参数，传出 events 事件
+        int num = epoll_wait(m_epfd, m_events, MAX_EVENT_NUMBER, -1); // -1永久阻塞
+        // epoll_wait调用错误 返回-1
+        if (num < 0 && errno != EINTR)
+        {
+            printf("epoll failure.\n");
+            break;
+        }
+        // 每轮只读一次单调时钟，本轮的定时器设置与到期检查都使用该缓存时间
+        m_timer_wheel->update_now();
+        // 循环遍历 epoll_wait 返回的事件
+        for (int i = 0; i < num; ++i)
+        {
+            int sockfd = m_events[i].data.fd;
+            http_conn *user = m_users + sockfd;
+            // 监听fd 有事件（新客户端连接） 本线程处理 监听fd通知
+            if (sockfd == m_listenfd)
+            {
+                handle_accept();
+            }
+            else if (sockfd == m_pipefd[0])
+            {
+                if (m_events[i].events & EPOLLIN)
+                {
+                    handle_signal();
+                }
+            }
+            else if (sockfd == m_timerfd)
+            {
+                handle_timerfd();
+            }
+            else if (m_events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            {
+                // 异常事件  对方异常断开 或者 错误等时间:EPOLLRDHUP|EPOLLHUP|EPOLLERR
+                // 回调函数 包括 删除epoll注册事件移除链接节点和关闭相应连接
+                user->m_timer->func(user);
+            }
+            else if (m_events[i].events & EPOLLIN)
+            {
+                handle_read(user);
+            }
+            else if (m_events[i].events & EPOLLOUT)
+            {
+                // 写数据就绪。not keep-alive，wirte返回false，关闭连接
+                if (user->write() == false)
+                {
+                    user->m_timer->func(user); // 写事件处理失败，关闭 用户请求任务
+                }
+                else if (user->pending())
+                {
+                    dispatch(user); // 读缓冲中还有流水线请求，不等待读事件 直接再次处理
+                }
+            }
+        }
+        // 如果 timerfd 已到期则处理定时事件。先执行I/O事件
+        if (m_timeout)
+        {
+            timer_handler();
+            m_timeout = false;
+        }
+    }
+}
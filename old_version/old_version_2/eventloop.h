@@ -0,0 +1,67 @@
+/*
+事件循环类（多 Reactor）：
+
+    每个 eventloop 拥有独立的 epoll 对象、独立的 SO_REUSEPORT 监听 socket 和独立的定时器时间轮，
+    由内核在多个监听 socket 之间分发新连接。连接从 accept 到 read/write 再到关闭，都只在
+    所属的 eventloop 线程中完成，从而使 accept/read/write 的吞吐量随核数扩展。
+    线程池仍然被所有 eventloop 共享，只负责解析 HTTP 请求、生成响应。
+*/
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <pthread.h>
+#include <sys/epoll.h>
+
+#include "http_conn.h"
+#include "threadpool.h"
+
+#define MAX_FD 10000           // 最大文件描述符个数
+#define MAX_EVENT_NUMBER 10000 // epoll最大监听文件描述符数量
+#define TIMESLOTS 5            // 连接超时时间 (秒)
+#define MAX_LOOP 64            // 最多允许的 eventloop 数量
+#define REPORT_MS 1000         // 过载/缓存统计 写入日志的间隔 (毫秒)
+
+class eventloop
+{
+public:
+    // id : 第几个事件循环，port : 监听端口，users : 所有事件循环共享的用户数组（按 fd 下标划分，互不冲突）
+    eventloop(int id, int port, http_conn *users, threadpool<http_conn> *pool);
+    ~eventloop();
+
+    void loop();                    // 事件循环主体
+    bool start();                   // 在新线程中运行 loop()
+    void join();                    // 等待 start() 创建的线程结束
+    static void *worker(void *arg); // 线程入口函数，调用 loop()
+
+    // 信号处理函数。将信号广播给所有 eventloop 的管道写端
+    static void sig_handler(int sig);
+
+private:
+    void handle_accept();              // 处理新连接
+    void handle_read(http_conn *user); // 处理读事件
+    void dispatch(http_conn *user);    // 将连接交给线程池处理，并在过载时拒绝请求
+    void handle_signal();              // 处理管道中的信号
+    void handle_timerfd();             // 处理 timerfd 到期通知
+    void timer_handler();              // 定时处理到期连接
+
+private:
+    int m_id;                      // 事件循环编号
+    int m_epfd;                    // 本循环独有的 epoll 对象
+    int m_listenfd;                // 本循环独有的监听 socket (SO_REUSEPORT)
+    int m_pipefd[2];               // 传递 信号 的管道。pipe[1] 用于写,pipe[0] 用于读
+    int m_timerfd;                 // 驱动时间轮的 timerfd，每 TIMER_TICK_MS 毫秒触发一次
+    timer_wheel *m_timer_wheel;    // 本循环所属连接的定时器时间轮
+    http_conn *m_users;            // 用户数组
+    threadpool<http_conn> *m_pool; // 共享线程池
+    epoll_event *m_events;         // epoll_wait 传出事件数组
+    pthread_t m_thread;            // 运行本循环的线程
+    bool m_stop;                   // 是否结束循环
+    bool m_timeout;                // 标记当前 timerfd 是否已到期
+    time_t m_last_report;          // 上次写入过载统计的时间
+
+    static int s_sig_pipefd[MAX_LOOP]; // 所有事件循环的管道写端，供信号处理函数广播
+    static int s_loop_size;            // 已注册的事件循环数量
+};
+
+#endif
@@ -0,0 +1,526 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#include "file_cache.h"
+#include "http_mime.h"
+#include "log.h"
+
+file_cache::file_cache() : m_max_entries(FILE_CACHE_MAX_ENTRIES / FILE_CACHE_SHARDS),
+                           m_max_bytes(FILE_CACHE_MAX_BYTES / FILE_CACHE_SHARDS),
+                           m_ttl_ms(FILE_CACHE_TTL_MS), m_policy(IO_POLICY_SENDFILE),
+                           m_io{IO_READ_MAX, IO_MMAP_MAX, IO_HOT_HITS},
+                           m_hits(0), m_misses(0), m_promotions(0), m_reported(0)
+{
+    for (int i = 0; i < FILE_CACHE_SHARDS; ++i)
+    {
+        m_shards[i].bytes = 0;
+        m_shards[i].generation = 0;
+    }
+    for (int i = 0; i < IO_COUNT; ++i)
+    {
+        m_loads[i] = 0;
+    }
+}
+
+// 释放缓存持有的引用
+file_cache::~file_cache()
+{
+    for (int i = 0; i < FILE_CACHE_SHARDS; ++i)
+    {
+        for (file_entry *e : m_shards[i].lru)
+        {
+            release(e);
+        }
+    }
+}
+
+// 设置缓存限制。在工作线程启动之前调用
+void file_cache::init(int max_entries, long long max_bytes, int ttl_ms, int policy, const io_thresholds &io)
+{
+    m_max_entries = (max_entries + FILE_CACHE_SHARDS - 1) / FILE_CACHE_SHARDS;
+    m_max_bytes = (max_bytes + FILE_CACHE_SHARDS - 1) / FILE_CACHE_SHARDS;
+    m_ttl_ms = ttl_ms;
+    m_policy = policy;
+    m_io = io;
+}
+
+// 单调时钟 (毫秒)，只用于判断是否需要重新校验，使用低精度时钟即可
+time_t file_cache::now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 按路径哈希选择分片
+file_cache::shard &file_cache::get_shard(std::string_view key)
+{
+    return m_shards[std::hash<std::string_view>()(key) % FILE_CACHE_SHARDS];
+}
+
+// 从 fd 读取 size 字节到 buf，文件被截断返回假
+static bool read_fd(int fd, char *buf, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = pread(fd, buf + done, size - done, done);
+        if (n <= 0)
+        {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+// 只读映射文件。populate 时由调用线程预先产生缺页，失败返回 NULL
+static char *map_file(int fd, size_t size, bool populate)
+{
+    // 内存映射  只读， 写入时，会产生映射文件的拷贝
+    char *addr = (char *)mmap(0, size, PROT_READ, MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fd, 0);
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+// 文件是否未被修改
+static bool same_file(const struct stat &a, const struct stat &b)
+{
+    return a.st_ino == b.st_ino && a.st_dev == b.st_dev && a.st_size == b.st_size && a.st_mode == b.st_mode &&
+           a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+// 预压缩文件是否可用：可读的普通文件，且不比原文件旧 (旧的预压缩文件视为过期)
+static bool usable_variant(const struct stat &vst, const struct stat &st)
+{
+    return S_ISREG(vst.st_mode) && (vst.st_mode & S_IROTH) &&
+           (vst.st_mtim.tv_sec > st.st_mtim.tv_sec ||
+            (vst.st_mtim.tv_sec == st.st_mtim.tv_sec && vst.st_mtim.tv_nsec >= st.st_mtim.tv_nsec));
+}
+
+// 文件及其预压缩变体 是否均未变化 (包括 变体的出现与消失)
+bool file_cache::unchanged(const char *path, const file_entry *entry)
+{
+    struct stat st;
+    if (stat(path, &st) != 0 || !same_file(st, entry->st))
+    {
+        return false;
+    }
+    if (!entry->compressible)
+    {
+        return true;
+    }
+    std::string sibling;
+    for (int i = 0; i < ENC_COUNT; ++i)
+    {
+        sibling = entry->path + encoding_suffixes[i];
+        struct stat vst;
+        bool exists = stat(sibling.c_str(), &vst) == 0 && usable_variant(vst, st);
+        if (exists != (entry->variants[i] != NULL) || (exists && !same_file(vst, entry->variants[i]->st)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 获取 path 对应的文件。命中且未过期直接返回；过期则重新 stat 校验；未命中则打开文件并加入缓存
+int file_cache::acquire(const char *path, file_entry **entry)
+{
+    std::string_view key(path);
+    shard &s = get_shard(key);
+    time_t now = now_ms();
+
+    file_entry *e = NULL;
+    s.lock.lock();
+    auto it = s.map.find(key);
+    if (it != s.map.end())
+    {
+        e = *it->second;
+        s.lru.splice(s.lru.begin(), s.lru, it->second); // 移到 LRU 表头
+        e->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    s.lock.unlock();
+
+    if (e != NULL)
+    {
+        if (now < e->expire.load(std::memory_order_relaxed))
+        {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            touch(e);
+            *entry = e;
+            return 0;
+        }
+        // 条目过期，重新 stat 校验。文件未变化则继续使用
+        if (unchanged(path, e))
+        {
+            e->expire.store(now + m_ttl_ms, std::memory_order_relaxed);
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            touch(e);
+            *entry = e;
+            return 0;
+        }
+        invalidate(path);
+        release(e);
+    }
+
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    // 加载在锁外进行，先记下失效代数：期间文件被修改时 读到的可能是旧的或不完整的内容
+    s.lock.lock();
+    unsigned generation = s.generation;
+    s.lock.unlock();
+    int ret = load(path, &e);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    *entry = insert(e, generation);
+    return 0;
+}
+
+// 打开文件，创建条目。错误码的判断顺序与原 do_request 相同
+int file_cache::load(const char *path, file_entry **entry)
+{
+    struct stat st;
+    if (stat(path, &st) < 0)
+    {
+        return ENOENT; // 不存在资源
+    }
+    if (!(st.st_mode & S_IROTH))
+    {
+        return EACCES; // 没有读权限
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+        return EISDIR; // 目录
+    }
+
+    const mime_entry *mime = mime_lookup(path);
+    file_entry *e;
+    int ret = open_entry(path, st, mime->type, -1, &e);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    // 可压缩的文本类型 打开 .br/.zst/.gz 预压缩文件。变体使用原文件的 Content-Type
+    e->compressible = mime->compressible;
+    if (e->compressible)
+    {
+        std::string sibling;
+        for (int i = 0; i < ENC_COUNT; ++i)
+        {
+            sibling = e->path + encoding_suffixes[i];
+            struct stat vst;
+            if (stat(sibling.c_str(), &vst) == 0 && usable_variant(vst, st) &&
+                open_entry(sibling.c_str(), vst, mime->type, i, &e->variants[i]) == 0)
+            {
+                e->encodings |= 1u << i;
+                e->bytes += vst.st_size;
+            }
+        }
+    }
+    build_header(e);
+    for (int i = 0; i < ENC_COUNT; ++i)
+    {
+        if (e->variants[i])
+        {
+            build_header(e->variants[i]);
+        }
+    }
+    *entry = e;
+    return 0;
+}
+
+// 打开一个已 stat 过的文件，按大小选择发送方式 并创建条目
+int file_cache::open_entry(const char *path, const struct stat &st, const char *content_type, int encoding,
+                           file_entry **entry)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return errno == ENOENT ? ENOENT : EACCES;
+    }
+    int io = choose_io(m_policy, st.st_size, 0, m_io);
+    char *addr = NULL;
+    if (io == IO_MMAP)
+    {
+        addr = map_file(fd, st.st_size, m_policy == IO_POLICY_AUTO);
+        if (addr == NULL)
+        {
+            close(fd);
+            return EIO;
+        }
+    }
+    else if (io == IO_READ)
+    {
+        // 小文件读入内存后 不再需要 fd。读取时文件被截断，则退回 sendfile
+        addr = new char[st.st_size];
+        if (read_fd(fd, addr, st.st_size))
+        {
+            close(fd);
+            fd = -1;
+        }
+        else
+        {
+            delete[] addr;
+            addr = NULL;
+            io = IO_SENDFILE;
+        }
+    }
+    m_loads[io].fetch_add(1, std::memory_order_relaxed);
+
+    file_entry *e = new file_entry;
+    e->path = path;
+    e->fd = fd;
+    e->st = st;
+    e->io = io;
+    e->addr.store(addr, std::memory_order_relaxed);
+    e->hits.store(0, std::memory_order_relaxed);
+    make_etag(st, e->etag, sizeof(e->etag));
+    format_http_date(st.st_mtim.tv_sec, e->last_modified, sizeof(e->last_modified));
+    e->content_type = content_type;
+    e->compressible = false;
+    e->encoding = encoding;
+    e->encodings = 0;
+    for (int i = 0; i < ENC_COUNT; ++i)
+    {
+        e->variants[i] = NULL;
+    }
+    e->bytes = st.st_size;
+    e->header_len = 0;
+    e->expire.store(now_ms() + m_ttl_ms, std::memory_order_relaxed);
+    e->refs.store(1, std::memory_order_relaxed);
+    e->cached = false;
+    *entry = e;
+    return 0;
+}
+
+// 生成 200 响应头部。预压缩变体带 Content-Encoding，有变体的条目、变体与可动态压缩的条目都带 Vary
+void file_cache::build_header(file_entry *e)
+{
+    int len = snprintf(e->header, sizeof(e->header), "%s %d %s\r\nContent-Length: %lld\r\nContent-Type:%s\r\n",
+                       "HTTP/1.1", 200, "OK", (long long)e->st.st_size, e->content_type);
+    if (e->encoding >= 0)
+    {
+        len += snprintf(e->header + len, sizeof(e->header) - len, "Content-Encoding: %s\r\n",
+                        encoding_names[e->encoding]);
+    }
+    if (e->encoding >= 0 || e->encodings != 0 || e->compressible)
+    {
+        len += snprintf(e->header + len, sizeof(e->header) - len, "%s", "Vary: Accept-Encoding\r\n");
+    }
+    len += snprintf(e->header + len, sizeof(e->header) - len, "Last-Modified: %s\r\nETag: %s\r\nAccept-Ranges: bytes\r\n",
+                    e->last_modified, e->etag);
+    e->header_len = len;
+}
+
+// 记录一次命中。只有 按大小与热度选择、且加载时为 sendfile 的条目才统计：
+// 命中次数恰好达到阈值的线程负责建立映射 (MAP_POPULATE 在工作线程中完成缺页)，映射失败则继续 sendfile
+void file_cache::touch(file_entry *e)
+{
+    if (m_policy != IO_POLICY_AUTO || e->io != IO_SENDFILE)
+    {
+        return;
+    }
+    int hits = e->hits.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (hits != m_io.hot_hits || choose_io(m_policy, e->st.st_size, hits, m_io) != IO_MMAP)
+    {
+        return;
+    }
+    char *addr = map_file(e->fd, e->st.st_size, true);
+    if (addr != NULL)
+    {
+        e->addr.store(addr, std::memory_order_release);
+        m_promotions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// 将条目加入缓存，淘汰 LRU 表尾 超出限制的条目。文件过大 或 缓存关闭时 不加入缓存，只供本次请求使用
+file_entry *file_cache::insert(file_entry *entry, unsigned generation)
+{
+    if (m_max_entries <= 0 || entry->bytes > m_max_bytes)
+    {
+        return entry;
+    }
+    shard &s = get_shard(entry->path);
+    std::vector<file_entry *> victims;
+
+    s.lock.lock();
+    if (s.generation != generation)
+    {
+        // 加载期间分片发生过失效，内容可能已过时，本次使用但不缓存
+        s.lock.unlock();
+        return entry;
+    }
+    auto it = s.map.find(entry->path);
+    if (it != s.map.end())
+    {
+        // 其他线程已加载同一文件，使用已有条目
+        file_entry *e = *it->second;
+        e->refs.fetch_add(1, std::memory_order_relaxed);
+        s.lock.unlock();
+        release(entry);
+        return e;
+    }
+    entry->refs.fetch_add(1, std::memory_order_relaxed); // 缓存持有一个引用
+    entry->cached = true;
+    s.lru.push_front(entry);
+    s.map[entry->path] = s.lru.begin();
+    s.bytes += entry->bytes;
+    while (s.lru.size() > 1 && ((int)s.map.size() > m_max_entries || s.bytes > m_max_bytes))
+    {
+        victims.push_back(s.lru.back());
+        erase(s, std::prev(s.lru.end()));
+    }
+    s.lock.unlock();
+
+    // 在锁外 释放被淘汰的条目
+    for (file_entry *e : victims)
+    {
+        release(e);
+    }
+    return entry;
+}
+
+// 从分片中移除条目，不释放缓存持有的引用 (需持有分片锁)
+void file_cache::erase(shard &s, std::list<file_entry *>::iterator it)
+{
+    file_entry *e = *it;
+    s.map.erase(std::string_view(e->path));
+    s.bytes -= e->bytes;
+    s.lru.erase(it);
+    e->cached = false;
+}
+
+// 使 path 对应的条目失效。正在发送的响应仍持有引用，发送完毕后才真正释放
+void file_cache::invalidate(const char *path)
+{
+    std::string_view key(path);
+    shard &s = get_shard(key);
+    file_entry *e = NULL;
+
+    s.lock.lock();
+    ++s.generation;
+    auto it = s.map.find(key);
+    if (it != s.map.end())
+    {
+        e = *it->second;
+        erase(s, it->second);
+    }
+    s.lock.unlock();
+
+    if (e != NULL)
+    {
+        release(e);
+    }
+}
+
+// 使所有条目失效。各分片的条目在锁内整体摘下，在锁外释放
+void file_cache::clear()
+{
+    for (int i = 0; i < FILE_CACHE_SHARDS; ++i)
+    {
+        shard &s = m_shards[i];
+        std::list<file_entry *> victims;
+        s.lock.lock();
+        for (file_entry *e : s.lru)
+        {
+            e->cached = false;
+        }
+        victims.swap(s.lru);
+        s.map.clear();
+        s.bytes = 0;
+        ++s.generation;
+        s.lock.unlock();
+
+        for (file_entry *e : victims)
+        {
+            release(e);
+        }
+    }
+}
+
+// 释放一个引用，最后一个引用释放时 关闭 fd、释放内存或解除映射
+void file_cache::release(file_entry *entry)
+{
+    if (entry->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    char *addr = entry->addr.load(std::memory_order_relaxed);
+    if (entry->io == IO_READ)
+    {
+        delete[] addr;
+    }
+    else if (addr)
+    {
+        munmap(addr, entry->st.st_size); // 加载时映射 或 命中后映射
+    }
+    if (entry->fd >= 0)
+    {
+        close(entry->fd);
+    }
+    for (int i = 0; i < ENC_COUNT; ++i)
+    {
+        if (entry->variants[i])
+        {
+            release(entry->variants[i]);
+        }
+    }
+    delete entry;
+}
+
+// 读取全部文件内容
+bool file_cache::read(const file_entry *entry, char *buf)
+{
+    size_t size = entry->st.st_size;
+    char *addr = entry->addr.load(std::memory_order_acquire);
+    if (addr)
+    {
+        memcpy(buf, addr, size);
+        return true;
+    }
+    return read_fd(entry->fd, buf, size);
+}
+
+// 换成预压缩变体。变体由 entry 持有一个引用，先加一引用 再释放 entry，变体不会在中途被释放
+file_entry *file_cache::variant(file_entry *entry, int encoding)
+{
+    file_entry *v = entry->variants[encoding];
+    v->refs.fetch_add(1, std::memory_order_relaxed);
+    release(entry);
+    getInstance()->touch(v);
+    return v;
+}
+
+// 命中次数
+long long file_cache::hit_count() const
+{
+    return m_hits.load(std::memory_order_relaxed);
+}
+
+// 未命中次数
+long long file_cache::miss_count() const
+{
+    return m_misses.load(std::memory_order_relaxed);
+}
+
+// 统计有变化时 写入日志
+void file_cache::report()
+{
+    long long hits = hit_count();
+    long long misses = miss_count();
+    if (hits + misses == m_reported)
+    {
+        return;
+    }
+    m_reported = hits + misses;
+    LOG_INFO("file cache: hits=%lld, misses=%lld, read=%lld, mmap=%lld, sendfile=%lld, promoted=%lld.", hits, misses,
+             m_loads[IO_READ].load(std::memory_order_relaxed), m_loads[IO_MMAP].load(std::memory_order_relaxed),
+             m_loads[IO_SENDFILE].load(std::memory_order_relaxed), m_promotions.load(std::memory_order_relaxed));
+}
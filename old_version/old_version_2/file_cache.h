@@ -0,0 +1,165 @@
+/*
+打开文件/元数据缓存类：
+
+    采用 单例模式 (懒汉模式)，所有工作线程共享
+    1. 以 完整路径 为键，缓存 文件 fd、struct stat、文件内容 (读入内存或 mmap 映射，见 io_strategy.h) 以及 预先生成的 200 响应头部，
+       命中时 do_request 不再 stat/open/mmap/close
+    2. 按路径哈希分为 FILE_CACHE_SHARDS 个分片，每个分片一把互斥锁 + LRU 链表，降低锁竞争
+    3. 条目创建后不再修改 (除过期时间)，通过引用计数管理生命周期：缓存持有一个引用，每个正在发送的响应持有一个引用，
+       条目被淘汰/失效后 直到最后一个响应发送完毕才关闭 fd、解除映射
+    4. 条目超过 TTL 后重新 stat 校验，文件未变化则继续使用；按 条目数量 与 文件总字节数 限制缓存大小
+    5. 统计 命中/未命中 次数，并定期写入日志
+    6. 加载时生成 ETag 与 Last-Modified，供条件请求判断与 304 响应使用
+    7. 按扩展名查表得到 Content-Type；可压缩的文本类型 同时打开 .br/.zst/.gz 预压缩文件作为该条目的变体，
+       变体有自己的 fd、ETag 与带 Content-Encoding/Vary 的头部，随基础条目一起缓存、失效
+*/
+
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "http_cond.h"
+#include "http_encoding.h"
+#include "io_strategy.h"
+#include "locker.h"
+
+#define FILE_CACHE_SHARDS 16                 // 分片数量
+#define FILE_CACHE_MAX_ENTRIES 4096          // 默认 最多缓存的文件数量
+#define FILE_CACHE_MAX_BYTES (256LL << 20)   // 默认 缓存文件的总字节数上限
+#define FILE_CACHE_TTL_MS 2000               // 默认 条目多久之后需要重新 stat 校验 (毫秒)
+#define FILE_CACHE_WATCH_TTL_MS 60000        // inotify 监听可用时的校验间隔，只作为兜底 (毫秒)
+#define FILE_HEADER_SIZE 384                 // 预先生成的响应头部 最大长度
+
+// 一个缓存的文件。创建后只读，由引用计数管理
+struct file_entry
+{
+    std::string path;                   // 文件完整路径 (缓存的键)
+    int fd;                             // 只读打开的 fd，读入内存的文件为 -1
+    struct stat st;                     // 文件状态
+    int io;                             // 加载时选择的发送方式 (IO_STRATEGY)
+    std::atomic<char *> addr;           // 文件内容 (读入的内存或映射地址)，不在内存中为 NULL。热点文件命中后可能由 NULL 变为映射地址
+    std::atomic<int> hits;              // 命中次数，用于判断是否为热点文件
+    const char *content_type;           // 响应的 Content-Type
+    bool compressible;                  // 是否为可压缩的文本类型 (会查找预压缩文件)
+    int encoding;                       // 本条目的 Content-Encoding (CONTENT_ENCODING)，未压缩为 -1
+    unsigned encodings;                 // 存在的预压缩变体 (按 CONTENT_ENCODING 的位掩码)
+    file_entry *variants[ENC_COUNT];    // 预压缩变体 (各持有一个引用)，没有为 NULL
+    long long bytes;                    // 本条目与变体的文件总字节数
+    char header[FILE_HEADER_SIZE];      // 预先生成的 响应首行 + Content-Length + Content-Type + Last-Modified + ETag + Accept-Ranges
+    int header_len;                     // 响应头部长度
+    char etag[ETAG_SIZE];               // 实体标签 (含引号)
+    char last_modified[HTTP_DATE_SIZE]; // 修改时间 (HTTP 日期)
+    std::atomic<time_t> expire;         // 到期后需要重新 stat 校验
+    std::atomic<int> refs;              // 引用计数
+    bool cached;                        // 是否在缓存中
+};
+
+class file_cache
+{
+public:
+    // C++11 之后，使用局部静态变量 懒汉模式 无需加锁处理
+    static file_cache *getInstance()
+    {
+        static file_cache instance;
+        return &instance;
+    }
+
+    // 设置缓存限制。max_entries/max_bytes 为 0 表示不缓存，policy (IO_POLICY) 与 io 决定文件内容的加载方式
+    void init(int max_entries, long long max_bytes, int ttl_ms, int policy, const io_thresholds &io);
+
+    // 获取 path 对应的文件，成功返回 0 并通过 entry 传出 (已加一引用，用完需 release)
+    // 失败返回 errno：ENOENT 不存在，EACCES 无读权限，EISDIR 为目录，其他为内部错误
+    int acquire(const char *path, file_entry **entry);
+
+    // 释放一个引用，最后一个引用释放时 关闭 fd、释放内存或解除映射
+    static void release(file_entry *entry);
+
+    // 读取条目的全部文件内容到 buf (至少 st_size 字节)。在内存中时直接拷贝，否则 pread。文件被截断返回假
+    static bool read(const file_entry *entry, char *buf);
+
+    // 重新 stat 校验：文件及其预压缩变体均未变化
+    static bool unchanged(const char *path, const file_entry *entry);
+
+    // 换成 encoding 对应的预压缩变体：返回已加一引用的变体，并释放 entry 的引用
+    static file_entry *variant(file_entry *entry, int encoding);
+
+    // 条目是否为热点文件 (命中次数达到阈值)，发送前不再检查是否在页缓存中
+    bool hot(const file_entry *entry) const
+    {
+        return entry->hits.load(std::memory_order_relaxed) >= m_io.hot_hits;
+    }
+
+    // 使 path 对应的条目失效
+    void invalidate(const char *path);
+
+    // 使所有条目失效
+    void clear();
+
+    // 命中/未命中 次数
+    long long hit_count() const;
+    long long miss_count() const;
+
+    // 统计有变化时 写入日志
+    void report();
+
+private:
+    file_cache();
+    ~file_cache();
+
+    // 分片：互斥锁 + 哈希表 + LRU 链表 (表头为最近使用)
+    struct shard
+    {
+        locker lock;
+        std::unordered_map<std::string_view, std::list<file_entry *>::iterator> map;
+        std::list<file_entry *> lru;
+        long long bytes;      // 本分片缓存的文件总字节数
+        unsigned generation;  // 失效代数：invalidate / clear 时递增
+    };
+
+    shard &get_shard(std::string_view key);
+    static time_t now_ms();
+
+    // 打开文件及其预压缩变体，创建条目 (引用计数为 1)
+    int load(const char *path, file_entry **entry);
+
+    // 打开一个已 stat 过的文件，创建条目 (不生成头部)
+    int open_entry(const char *path, const struct stat &st, const char *content_type, int encoding,
+                   file_entry **entry);
+
+    // 生成条目的 200 响应头部
+    static void build_header(file_entry *entry);
+
+    // 记录一次命中。中等大小的文件 命中次数达到阈值时 建立映射
+    void touch(file_entry *entry);
+
+    // 将条目加入缓存并淘汰超出限制的条目。已存在同名条目时 保留已有条目，返回它
+    // generation 为加载前读取的分片失效代数，加载期间发生过失效时 条目不入缓存，仅返回给调用者
+    file_entry *insert(file_entry *entry, unsigned generation);
+
+    // 从分片中移除条目 (需持有分片锁)
+    void erase(shard &s, std::list<file_entry *>::iterator it);
+
+private:
+    shard m_shards[FILE_CACHE_SHARDS]; // 分片
+    int m_max_entries;                 // 每个分片 最多缓存的文件数量
+    long long m_max_bytes;             // 每个分片 缓存文件的总字节数上限
+    int m_ttl_ms;                      // 条目校验间隔
+    int m_policy;                      // 文件内容的加载方式 (IO_POLICY)
+    io_thresholds m_io;                // 按大小与热度选择发送方式的阈值
+
+    std::atomic<long long> m_hits;             // 命中次数
+    std::atomic<long long> m_misses;           // 未命中次数
+    std::atomic<long long> m_loads[IO_COUNT];  // 各发送方式 加载的文件数
+    std::atomic<long long> m_promotions;       // 命中后建立映射的文件数
+    long long m_reported;                      // 上次写入日志时的 总查询次数
+};
+
+#endif
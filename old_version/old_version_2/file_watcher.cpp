@@ -0,0 +1,236 @@
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <exception>
+
+#include "file_watcher.h"
+#include "file_cache.h"
+#include "response_cache.h"
+#include "compress_cache.h"
+#include "log.h"
+
+// 文件内容或属性变化 / 移入移出 / 删除，以及 用于维护目录监听的事件
+#define WATCH_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE)
+
+// 创建 inotify 实例与退出管道，监听整棵目录树
+file_watcher::file_watcher(const char *root) : m_root(root), m_inotify_fd(-1), m_thread(0)
+{
+    m_pipefd[0] = m_pipefd[1] = -1;
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify_fd == -1)
+    {
+        throw std::exception();
+    }
+    if (pipe(m_pipefd) == -1)
+    {
+        close(m_inotify_fd);
+        throw std::exception();
+    }
+    // 去掉末尾的 '/'，使拼出的路径与 do_request 中 doc_root + url 一致
+    while (m_root.size() > 1 && m_root.back() == '/')
+    {
+        m_root.pop_back();
+    }
+    add_tree(m_root, 0);
+    if (m_dirs.empty())
+    {
+        close(m_inotify_fd);
+        close(m_pipefd[0]);
+        close(m_pipefd[1]);
+        throw std::exception(); // 根目录无法监听
+    }
+    LOG_INFO("file watcher: watching %d directories under %s.", (int)m_dirs.size(), m_root.c_str());
+}
+
+file_watcher::~file_watcher()
+{
+    stop();
+    close(m_inotify_fd); // 关闭 inotify 实例，同时移除所有监听
+    close(m_pipefd[0]);
+    close(m_pipefd[1]);
+}
+
+// 线程入口函数
+void *file_watcher::worker(void *arg)
+{
+    file_watcher *fw = (file_watcher *)arg;
+    fw->loop();
+    return fw;
+}
+
+// 在新线程中运行 loop()
+bool file_watcher::start()
+{
+    return pthread_create(&m_thread, NULL, worker, this) == 0;
+}
+
+// 通知监听线程退出，并等待其结束
+void file_watcher::stop()
+{
+    if (m_thread)
+    {
+        char msg = 0;
+        write(m_pipefd[1], &msg, 1);
+        pthread_join(m_thread, NULL);
+        m_thread = 0;
+    }
+}
+
+// 递归监听 dir 及其所有子目录。已监听的目录 inotify_add_watch 返回原监听描述符，只更新其路径
+void file_watcher::add_tree(const std::string &dir, int depth)
+{
+    if (depth > WATCH_MAX_DEPTH)
+    {
+        return;
+    }
+    int wd = inotify_add_watch(m_inotify_fd, dir.c_str(), WATCH_MASK | IN_ONLYDIR);
+    if (wd == -1)
+    {
+        LOG_ERROR("file watcher: watch %s failure, errno is %d.", dir.c_str(), errno);
+        return;
+    }
+    m_dirs[wd] = dir;
+
+    DIR *dp = opendir(dir.c_str());
+    if (dp == NULL)
+    {
+        return;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(dp)) != NULL)
+    {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+        {
+            continue;
+        }
+        std::string path = dir + "/" + ent->d_name;
+        bool is_dir = ent->d_type == DT_DIR;
+        if (ent->d_type == DT_UNKNOWN || ent->d_type == DT_LNK)
+        {
+            // 文件系统不提供类型 或 为符号链接 (do_request 的 stat 会跟随链接)
+            struct stat st;
+            is_dir = stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (is_dir)
+        {
+            add_tree(path, depth + 1);
+        }
+    }
+    closedir(dp);
+}
+
+// 监听主体：等待 inotify 事件 或 退出通知
+void file_watcher::loop()
+{
+    struct pollfd fds[2];
+    fds[0].fd = m_inotify_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_pipefd[0];
+    fds[1].events = POLLIN;
+
+    while (true)
+    {
+        int ret = poll(fds, 2, -1);
+        if (ret < 0 && errno != EINTR)
+        {
+            LOG_ERROR("%s", "file watcher: poll failure.");
+            break;
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            break; // 收到退出通知
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            handle_events();
+        }
+    }
+}
+
+// 读取并处理 inotify 事件
+void file_watcher::handle_events()
+{
+    char buf[WATCH_EVENT_BUF] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true)
+    {
+        ssize_t len = read(m_inotify_fd, buf, sizeof(buf));
+        if (len <= 0)
+        {
+            return; // EAGAIN：事件已读完
+        }
+        for (char *p = buf; p < buf + len;)
+        {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                // 事件队列溢出，丢失了部分事件，无法确定哪些文件变化了
+                LOG_WARN("%s", "file watcher: event queue overflow, flush caches.");
+                invalidate_all();
+                continue;
+            }
+            if (ev->mask & IN_IGNORED)
+            {
+                m_dirs.erase(ev->wd); // 目录被删除 或 所在文件系统被卸载，监听已被内核移除
+                continue;
+            }
+            auto it = m_dirs.find(ev->wd);
+            if (it == m_dirs.end() || ev->len == 0)
+            {
+                continue;
+            }
+            std::string path = it->second + "/" + ev->name;
+
+            if (ev->mask & IN_ISDIR)
+            {
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    add_tree(path, 0); // 新建/移入的目录
+                }
+                if (ev->mask & (IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE))
+                {
+                    // 整个目录的路径都变了，缓存中无法按前缀查找，直接清空
+                    invalidate_all();
+                }
+                continue;
+            }
+            if (ev->mask & (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE))
+            {
+                invalidate(path);
+            }
+        }
+    }
+}
+
+// 使 path 在各缓存中失效。正在发送的响应仍持有旧条目的引用，下一个请求重新加载
+// 预压缩文件 (.br/.zst/.gz) 是原文件条目的变体，其变化同时使原文件失效
+void file_watcher::invalidate(const std::string &path)
+{
+    file_cache::getInstance()->invalidate(path.c_str());
+    response_cache::getInstance()->invalidate(path.c_str());
+    compress_cache::getInstance()->invalidate(path.c_str());
+    for (int i = 0; i < ENC_COUNT; ++i)
+    {
+        size_t len = strlen(encoding_suffixes[i]);
+        if (path.size() > len && path.compare(path.size() - len, len, encoding_suffixes[i]) == 0)
+        {
+            std::string base = path.substr(0, path.size() - len);
+            file_cache::getInstance()->invalidate(base.c_str());
+            response_cache::getInstance()->invalidate(base.c_str());
+            compress_cache::getInstance()->invalidate(base.c_str());
+        }
+    }
+}
+
+// 清空各缓存
+void file_watcher::invalidate_all()
+{
+    file_cache::getInstance()->clear();
+    response_cache::getInstance()->clear();
+    compress_cache::getInstance()->clear();
+}
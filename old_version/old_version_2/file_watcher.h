@@ -0,0 +1,50 @@
+/*
+文件变化监听类：
+
+    在独立线程中用 inotify 监听 doc_root 整棵目录树，文件被改写/替换/删除时 使 file_cache、response_cache、compress_cache 中
+    对应的条目失效，缓存不必再靠 TTL 定期 stat 校验
+    1. 监听 IN_MODIFY / IN_CLOSE_WRITE / IN_ATTRIB / IN_MOVED_TO / IN_MOVED_FROM / IN_DELETE：
+       原地改写在写入过程中和写完关闭时各失效一次，写入过程中被读入缓存的半截内容不会留下来
+    2. 失效只是把条目从哈希表中摘下 (替换为 "不存在")，条目本身不可变且由引用计数管理：
+       正在发送的响应继续使用旧条目直到发送完毕，下一个请求重新加载新文件，读者不会看到被改到一半的缓存内容
+    3. 预压缩文件 (.br/.zst/.gz) 变化时 同时使原文件失效，原文件条目重新加载时重新查找预压缩文件
+    4. 新建/移入的子目录自动加入监听；目录被移走/删除、或 inotify 队列溢出时 清空整个缓存
+*/
+
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <pthread.h>
+#include <string>
+#include <unordered_map>
+
+#define WATCH_EVENT_BUF 4096 // 每次读取 inotify 事件的缓冲区大小
+#define WATCH_MAX_DEPTH 32   // 最多监听的目录层数，防止符号链接成环
+
+class file_watcher
+{
+public:
+    // root : 监听的根目录 (doc_root)。inotify 初始化失败时 抛出异常
+    file_watcher(const char *root);
+    ~file_watcher();
+
+    bool start();                   // 在新线程中运行 loop()
+    void stop();                    // 通知监听线程退出，并等待其结束
+    static void *worker(void *arg); // 线程入口函数，调用 loop()
+
+private:
+    void loop();                                     // 监听主体
+    void add_tree(const std::string &dir, int depth); // 递归监听 dir 及其所有子目录
+    void handle_events();                            // 读取并处理 inotify 事件
+    static void invalidate(const std::string &path); // 使 path 在各缓存中失效
+    static void invalidate_all();                    // 清空各缓存
+
+private:
+    std::string m_root;                         // 根目录
+    int m_inotify_fd;                           // inotify 实例
+    int m_pipefd[2];                            // 通知线程退出的管道。pipe[1] 用于写,pipe[0] 用于读
+    std::unordered_map<int, std::string> m_dirs; // 监听描述符 -> 目录路径 (只在监听线程中访问)
+    pthread_t m_thread;                         // 监听线程
+};
+
+#endif
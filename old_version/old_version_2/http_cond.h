@@ -0,0 +1,149 @@
+/*
+条件请求：
+
+    1. 实体标签 (ETag) 由 inode、文件大小、修改时间 (纳秒) 生成，文件被替换或改写后必然变化
+    2. HTTP 日期 (Last-Modified / If-Modified-Since) 的格式化与解析，解析支持 RFC 7231 规定的三种格式
+    3. 按 RFC 7232 判断是否返回 304：有 If-None-Match 时只看实体标签 (弱比较)，否则比较 If-Modified-Since
+    4. If-Range：实体标签强比较相等，或日期与修改时间完全一致时，Range 才生效
+*/
+
+#ifndef HTTP_COND_H
+#define HTTP_COND_H
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <string_view>
+
+#define ETAG_SIZE 80      // 实体标签 最大长度 (含引号与 W/ 前缀)
+#define HTTP_DATE_SIZE 32 // HTTP 日期 最大长度
+
+// 生成实体标签 "inode-大小-修改时间"，返回长度
+inline int make_etag(const struct stat &st, char *buf, size_t size)
+{
+    unsigned long long mtime = (unsigned long long)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+    return snprintf(buf, size, "\"%llx-%llx-%llx\"", (unsigned long long)st.st_ino,
+                    (unsigned long long)st.st_size, mtime);
+}
+
+// 格式化为 IMF-fixdate：Sun, 06 Nov 1994 08:49:37 GMT。返回长度
+inline int format_http_date(time_t t, char *buf, size_t size)
+{
+    static const char *days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                   "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    return snprintf(buf, size, "%s, %02d %s %04d %02d:%02d:%02d GMT", days[tm.tm_wday], tm.tm_mday,
+                    months[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+// 解析 HTTP 日期：IMF-fixdate、RFC 850、asctime 三种格式。成功返回真
+inline bool parse_http_date(std::string_view value, time_t *t)
+{
+    char buf[HTTP_DATE_SIZE * 2];
+    if (value.empty() || value.size() >= sizeof(buf))
+    {
+        return false;
+    }
+    memcpy(buf, value.data(), value.size());
+    buf[value.size()] = '\0';
+
+    static const char *formats[] = {
+        "%a, %d %b %Y %H:%M:%S GMT", // Sun, 06 Nov 1994 08:49:37 GMT
+        "%A, %d-%b-%y %H:%M:%S GMT", // Sunday, 06-Nov-94 08:49:37 GMT
+        "%a %b %e %H:%M:%S %Y",      // Sun Nov  6 08:49:37 1994
+    };
+    for (const char *format : formats)
+    {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        const char *end = strptime(buf, format, &tm);
+        if (end != NULL && *end == '\0')
+        {
+            *t = timegm(&tm);
+            return true;
+        }
+    }
+    return false;
+}
+
+// If-None-Match 列表中是否有与 etag 弱比较相等的标签 (双方都忽略 W/ 前缀)，"*" 匹配任意标签
+inline bool etag_match(std::string_view list, std::string_view etag)
+{
+    if (etag.size() > 2 && etag[0] == 'W' && etag[1] == '/')
+    {
+        etag.remove_prefix(2);
+    }
+    size_t pos = 0;
+    while (pos < list.size())
+    {
+        // 跳过 分隔符与空白
+        while (pos < list.size() && (list[pos] == ',' || list[pos] == ' ' || list[pos] == '\t'))
+        {
+            ++pos;
+        }
+        if (pos >= list.size())
+        {
+            break;
+        }
+        size_t end = list.find(',', pos);
+        if (end == std::string_view::npos)
+        {
+            end = list.size();
+        }
+        std::string_view tag = list.substr(pos, end - pos);
+        while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t'))
+        {
+            tag.remove_suffix(1);
+        }
+        if (tag == "*")
+        {
+            return true;
+        }
+        if (tag.size() > 2 && tag[0] == 'W' && tag[1] == '/')
+        {
+            tag.remove_prefix(2);
+        }
+        if (tag == etag)
+        {
+            return true;
+        }
+        pos = end;
+    }
+    return false;
+}
+
+// 客户端缓存的副本是否仍然有效。if_none_match/if_modified_since 为空表示请求中没有该头部
+inline bool not_modified(std::string_view if_none_match, std::string_view if_modified_since,
+                         std::string_view etag, time_t mtime)
+{
+    if (!if_none_match.empty())
+    {
+        return etag_match(if_none_match, etag); // 有 If-None-Match 时 忽略 If-Modified-Since
+    }
+    time_t since;
+    if (if_modified_since.empty() || !parse_http_date(if_modified_since, &since))
+    {
+        return false;
+    }
+    return since <= time(NULL) && mtime <= since; // 晚于当前时间的日期无效
+}
+
+// If-Range 是否成立。if_range 为空表示请求中没有该头部 (Range 直接生效)
+inline bool if_range_match(std::string_view if_range, std::string_view etag, time_t mtime)
+{
+    if (if_range.empty())
+    {
+        return true;
+    }
+    if (if_range[0] == '"' || if_range.substr(0, 2) == "W/")
+    {
+        return if_range == etag; // 强比较：弱标签不匹配
+    }
+    time_t date;
+    return parse_http_date(if_range, &date) && date == mtime;
+}
+
+#endif
@@ -1,13 +1,23 @@
 #include "http_conn.h"
+#include "buffer_pool.h"
+#include "file_cache.h"
+#include "response_cache.h"
+#include "compress_cache.h"
+#include "io_reader.h"
+#include "http_scan.h"
+#include "overload.h"
 
 // 定义 HTTP 相应的一些状态信息
 const char *ok_200_title = "OK";
+const char *partial_206_title = "Partial Content";
+const char *not_modified_304_title = "Not Modified";
 const char *error_400_title = "Bad Request";
 const char *error_400_form = "Your request has bad syntax or is inherently impossible to satisfy.\n";
 const char *error_403_title = "Forbidden";
 const char *error_403_form = "You do not have permission to get file from this server.\n";
 const char *error_404_title = "Not Found";
 const char *error_404_form = "The requested file was not found on this server.\n";
+const char *error_416_title = "Range Not Satisfiable";
 const char *error_500_title = "Internal Error";
 const char *error_500_form = "There was an unusual problem serving the requested file.\n";
 
@@ -15,10 +25,11 @@ const char *error_500_form = "There was an unusual problem serving the requested
 const char *doc_root = "/home/devil/linux/web1/src";
 
 // 类静态变量成员 初始化
-int http_conn::m_epfd = -1;     // 所有socket事件都被注册到同一个epoll对象中
-int http_conn::m_user_size = 0; // 统计当前用户数量
-timer_list *http_conn::timer_lst = new timer_list();
-int http_conn::pipefd[2] = {-1, -1}; // 初始化
+std::atomic<int> http_conn::m_user_size(0); // 统计当前用户数量
+int http_conn::m_send_mode = http_conn::SEND_AUTO; // 默认 按文件大小与热度选择发送方式
+
+// 多范围响应的分隔符序号
+static std::atomic<unsigned> s_boundary(0);
 
 // 为fd设置非阻塞属性
 int setnonblocking(int fd)
@@ -64,12 +75,12 @@ void modifyfd(int epfd, int fd, int ev)
 }
 
 // 定时回调函数 信号调用处理函数
-// 移除 epoll 注册事件，在 链表中 移除该节点，关闭http连接
+// 移除 epoll 注册事件，在 时间轮中 移除该节点，关闭http连接
 void back_func(http_conn *user_data)
 {
     printf("执行 back_func     ");
-    // 在 链表中 移除该节点
-    http_conn::timer_lst->del_timer(user_data->m_timer);
+    // 在 时间轮中 移除该节点
+    user_data->m_timer_wheel->del_timer(user_data->m_timer);
 
     // 关闭http连接  关闭 fd
     user_data->close_conn();
@@ -82,13 +93,10 @@ void back_func(http_conn *user_data)
 void http_conn::close_conn()
 {
     printf("执行 close_conn\n");
-    // 关闭该 fd
-    if (m_sockfd != -1)
-    {
-        removefd(m_epfd, m_sockfd); // 从epfd 中 删除 fd
-        m_sockfd = -1;              // 重置 fd 为-1
-        --m_user_size;              // 总用户数量 - 1
-    }
+    int sockfd = m_sockfd;
+
+    // 取消可能的预读等待，I/O 线程之后不会再为该 fd 注册事件
+    io_reader::getInstance()->cancel(this);
 
     // 关闭定时器链接
     if (m_timer)
@@ -96,15 +104,29 @@ void http_conn::close_conn()
         delete m_timer;
         m_timer = nullptr;
     }
+
+    unmap();           // 释放 未发送完的响应 占用的映射与文件
+    release_buffers(); // 归还 读/写缓冲
+
+    // 关闭该 fd。必须最后关闭：fd 一旦关闭，其他事件循环可能立即 accept 到同一 fd 并重新初始化该对象
+    if (sockfd != -1)
+    {
+        m_sockfd = -1;            // 重置 fd 为-1
+        --m_user_size;            // 总用户数量 - 1
+        removefd(m_epfd, sockfd); // 从epfd 中 删除 fd 并关闭
+    }
 }
 
 // 初始化新接收的 用户连接任务请求。（将用户连接信息都封装在 http 任务类内）
-void http_conn::init(int sockfd, const sockaddr_in &addr)
+void http_conn::init(int sockfd, const sockaddr_in &addr, int epfd, timer_wheel *timer_wheel)
 {
     printf("执行 新客户端连接 init( ) \n");
     m_sockfd = sockfd;
     m_addr = addr;
-    m_timer = nullptr; // 初始化 新的 连接。 节点置空
+    m_epfd = epfd;           // 连接归属的事件循环
+    m_timer_wheel = timer_wheel; // 连接归属的定时器时间轮
+    m_timer = nullptr;       // 初始化 新的 连接。 节点置空
+    m_io_wait.store(false);
 
     // 设置 通信 socket 端口复用，1 表示端口复用
     int reuse = 1;
@@ -121,7 +143,26 @@ void http_conn::init()
 {
     bytes_to_send = 0;
     bytes_have_send = 0;
+    m_file = NULL;
+    m_cached = NULL;
+    m_resp_count = 0;
+    m_seg_count = 0;
+    m_iv_count = 0;
+    m_iv_index = 0;
+    m_keep_alive = false;
+    m_pending = false;
 
+    m_checked_index = 0; // 当前需要解析的字符地址
+    m_read_index = 0;    // 当前读缓冲光标地址
+    m_write_index = 0;   // 当前写缓冲光标地址
+    init_request();
+
+    release_buffers(); // 归还 读/写缓冲
+}
+
+// 初始化 下一个请求的解析状态。新请求从 m_checked_index 开始，之前读入的流水线数据保留
+void http_conn::init_request()
+{
     m_check_state = CHECK_STATE_REQUESTLINE; // 主状态机  初始状态为：解析请求首行
     m_linger = false;                        // 默认不保持连接
     m_method = GET;                          // 默认请求方式为GET
@@ -129,33 +170,145 @@ void http_conn::init()
     m_version = 0;
     m_content_length = 0;
     m_host = 0;
+    m_range_count = 0;
 
-    m_start_line = 0;    // 当前需要解析的 请求行索引地址
-    m_checked_index = 0; // 当前需要解析的字符地址
-    m_read_index = 0;    // 当前读缓冲光标地址
-    m_write_index = 0;   // 当前写缓冲光标地址
+    m_request_start = m_checked_index; // 当前请求的起始地址
+    m_start_line = m_checked_index;    // 当前需要解析的 请求行索引地址
+    http_scan_reset(&m_scan);          // 从请求起始处 扫描请求头部
+    m_headers.clear();                 // 清空头部表
+
+    bzero(m_real_file, FILENAME_LEN); // 清空 资源文件名
+}
+
+// 一批响应发送完毕。把尚未处理的流水线数据搬到读缓冲开头，没有剩余数据则归还缓冲区
+void http_conn::finish_response()
+{
+    bytes_to_send = 0;
+    bytes_have_send = 0;
+    m_resp_count = 0;
+    m_seg_count = 0;
+    m_iv_count = 0;
+    m_iv_index = 0;
+    m_write_index = 0;
+
+    int shift = m_request_start;
+    if (shift == m_read_index)
+    {
+        // 没有剩余数据，空闲连接不持有缓冲区
+        m_checked_index = 0;
+        m_read_index = 0;
+        init_request();
+        release_buffers();
+        m_pending = false;
+        return;
+    }
+    if (shift > 0)
+    {
+        memmove(m_read_buf, m_read_buf + shift, m_read_index - shift + 1); // 连同末尾的 '\0'
+        rebase_read_buf(m_read_buf, m_read_buf - shift);
+        m_request_start = 0;
+        m_start_line -= shift;
+        m_checked_index -= shift;
+        m_read_index -= shift;
+    }
+    buffer_pool::getInstance()->release(m_write_buf, m_write_size);
+    m_write_buf = NULL;
+    m_write_size = 0;
+}
+
+// 读缓冲数据从 old_base 移动到 new_base 后，重新定位已解析出的指针与头部表
+void http_conn::rebase_read_buf(const char *old_base, char *new_base)
+{
+    m_url = m_url ? new_base + (m_url - old_base) : NULL;
+    m_version = m_version ? new_base + (m_version - old_base) : NULL;
+    m_host = m_host ? new_base + (m_host - old_base) : NULL;
+    m_headers.rebase(old_base, new_base);
+}
+
+// 读缓冲 增长到不小于 size 字节。数据搬到新缓冲后，已解析出的指针与头部表 一并重新定位
+bool http_conn::grow_read_buf(int size)
+{
+    if (size > MAX_REQUEST_SIZE)
+    {
+        return false; // 请求过大
+    }
+    int new_size = 0;
+    char *new_buf = buffer_pool::getInstance()->acquire(size, &new_size);
+    if (new_buf == NULL)
+    {
+        return false;
+    }
+    char *old_buf = m_read_buf;
+    if (old_buf != NULL)
+    {
+        memcpy(new_buf, old_buf, m_read_index);
+        rebase_read_buf(old_buf, new_buf);
+        buffer_pool::getInstance()->release(old_buf, m_read_size);
+    }
+    m_read_buf = new_buf;
+    m_read_size = new_size;
+    return true;
+}
 
-    bzero(m_read_buf, READ_BUF_SIZE);   // 清空读缓冲
-    bzero(m_write_buf, WRITE_BUF_SIZE); // 清空写缓冲
-    bzero(m_real_file, FILENAME_LEN);   // 清空 资源文件名
+// 写缓冲 增长到不小于 size 字节。响应的内存块在一批响应生成完毕后才设置，可以直接搬移
+bool http_conn::grow_write_buf(int size)
+{
+    int new_size = 0;
+    char *new_buf = buffer_pool::getInstance()->acquire(size, &new_size);
+    if (new_buf == NULL)
+    {
+        return false;
+    }
+    if (m_write_buf != NULL)
+    {
+        memcpy(new_buf, m_write_buf, m_write_index);
+        buffer_pool::getInstance()->release(m_write_buf, m_write_size);
+    }
+    m_write_buf = new_buf;
+    m_write_size = new_size;
+    return true;
+}
+
+// 归还 读/写缓冲
+void http_conn::release_buffers()
+{
+    buffer_pool *pool = buffer_pool::getInstance();
+    pool->release(m_read_buf, m_read_size);
+    m_read_buf = NULL;
+    m_read_size = 0;
+    pool->release(m_write_buf, m_write_size);
+    m_write_buf = NULL;
+    m_write_size = 0;
 }
 
 // 循环读取客户数据，直到无数据可读或者对方关闭连接
 bool http_conn::read()
 {
-    if (m_read_index >= READ_BUF_SIZE)
+    // 栈上溢出区：读缓冲剩余空间不足时，多出的数据先读到这里，避免为了扩容多次调用 recv
+    char spill[READ_SPILL_SIZE];
+    struct iovec iv[2];
+
+    // 上次处理后读缓冲仍是满的，说明其中连一个完整请求都没有：单个请求超过 MAX_REQUEST_SIZE
+    if (m_read_index >= MAX_REQUEST_SIZE - 1)
     {
-        return false; // 读缓冲溢出
+        return false;
     }
-    int bytes_read = 0; // 临时保存 recv 每次读取的字节大小
-    // 循环读取 socket 通信数据
-    while (true)
+    while (m_read_index < MAX_REQUEST_SIZE - 1)
     {
+        // 读缓冲 保留 1 字节存放 '\0'。最多读到 MAX_REQUEST_SIZE，多出的流水线数据留在 socket 中，处理完当前数据后再读
+        int limit = MAX_REQUEST_SIZE - 1 - m_read_index;
+        int room = m_read_buf ? m_read_size - 1 - m_read_index : 0;
+        int spill_len = limit - room < (int)sizeof(spill) ? limit - room : (int)sizeof(spill);
+        iv[0].iov_base = m_read_buf + m_read_index;
+        iv[0].iov_len = room;
+        iv[1].iov_base = spill;
+        iv[1].iov_len = spill_len;
+
         // 从 socket 中读取数据
-        bytes_read = recv(m_sockfd, m_read_buf + m_read_index, READ_BUF_SIZE - m_read_index, 0);
+        int bytes_read = readv(m_sockfd, iv, 2);
         if (bytes_read == -1)
         {
-            if (errno == EAGAIN | errno == EWOULDBLOCK)
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
             { // 有 无数据 的通知，退出循环  // 没有数据
                 break;
             }
@@ -165,58 +318,46 @@ bool http_conn::read()
         {
             return false; // 对方关闭连接
         }
-        // 读取成功
-        m_read_index += bytes_read;
-    }
-    // printf("读取到的数据:\n%s\n", m_read_buf);
-    return true;
-}
 
-// 解析一行数据  判断依据 \r\n。遇到 \r\n 替换为 \0\0，取地址字符串就会自动分开
-http_conn::LINE_STATUS http_conn::parse_line()
-{
-    char temp; // 扫描字符
-    for (; m_checked_index < m_read_index; ++m_checked_index)
-    {
-        temp = m_read_buf[m_checked_index];
-        // 遇到 \r\n 就会返回，所以每次只会解析一行。 m_checked_index为下一行首地址
-        if (temp == '\r')
+        // 读取成功。超出读缓冲的部分 在扩容后从溢出区拷入
+        if (bytes_read <= room)
         {
-            if ((m_checked_index + 1) == m_read_index)
-            {
-                return LINE_OPEN; // 返回数据不完整
-            }
-            else if (m_read_buf[m_checked_index + 1] == '\n')
-            {
-                m_read_buf[m_checked_index++] = '\0'; // \r 置为字符串结束符。
-                m_read_buf[m_checked_index++] = '\0'; // \n 置为字符串结束符。
-                return LINE_OK;                       //  当前行解析成功
-            }
-            return LINE_BAD;
+            m_read_index += bytes_read;
         }
-        else if (temp == '\n')
+        else
         {
-            if ((m_checked_index > 1) && (m_read_buf[m_checked_index - 1] == '\r'))
+            int extra = bytes_read - room;
+            m_read_index += room;
+            if (!grow_read_buf(m_read_index + extra + 1))
             {
-                m_read_buf[m_checked_index - 1] = '\0'; // \r 置为字符串结束符。
-                m_read_buf[m_checked_index++] = '\0';   // \n 置为字符串结束符。
-                return LINE_OK;
+                return false;
             }
-            return LINE_BAD;
+            memcpy(m_read_buf + m_read_index, spill, extra);
+            m_read_index += extra;
+        }
+        m_read_buf[m_read_index] = '\0';
+
+        // 没有读满 说明 socket 接收缓冲已读空，省去一次返回 EAGAIN 的调用
+        if (bytes_read < room + spill_len)
+        {
+            break;
         }
     }
-    return LINE_OPEN;
+    // printf("读取到的数据:\n%s\n", m_read_buf);
+    return true;
 }
 
 // 解析请求首行, 获取请求方法，目标URL，HTTP版本
-http_conn::HTTP_CODE http_conn::parse_request_line(char *text)
+// 两个分隔符的位置 已由请求头部扫描给出，方法与版本只按已知长度比较
+http_conn::HTTP_CODE http_conn::parse_request_line(char *base, const http_line &line)
 {
-    // printf("请求行:%s\n", text);
     // "GET /index.html HTTP/1.1"
-    m_url = strpbrk(text, " \t"); // 找第一个空格或者\t在text出现的位置
+    char *text = base + line.begin;
+    char *end = base + line.end;
+    m_url = line.delim1 < 0 ? end : base + line.delim1; // 第一个空格或者\t的位置
 
     // 如果不存在 直接返回非法
-    if (!m_url)
+    if (m_url == end)
     {
         return BAD_REQUEST;
     }
@@ -225,7 +366,7 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char *text)
     *m_url++ = '\0'; // "GET\0/index.html HTTP/1.1", m_url++ 指向 /index.html HTTP/1.1
 
     char *method = text; // 即 GET
-    if (strcasecmp(method, "GET") == 0)
+    if (m_url - text == 4 && strncasecmp(method, "GET", 3) == 0)
     {
         m_method = GET;
     }
@@ -234,15 +375,15 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char *text)
         return BAD_REQUEST; // 否则为错误请求
     }
 
-    // 检索字符串 str1 中出现的第一个 str2 中字符的下标。
-    m_version = strpbrk(m_url, " \t"); // "/index.html HTTP/1.1"
-    if (!m_version)
+    // 第二个 空格或者\t 的位置
+    m_version = line.delim2 < 0 ? end : base + line.delim2; // "/index.html HTTP/1.1"
+    if (m_version == end)
     {
         return BAD_REQUEST;
     }
 
     *m_version++ = '\0'; // "/index.html\0HTTP/1.1"  m_version++ 指向HTTP/1.1
-    if (strcasecmp(m_version, "HTTP/1.1") != 0)
+    if (end - m_version != 8 || strncasecmp(m_version, "HTTP/1.1", 8) != 0)
     {
         return BAD_REQUEST;
     }
@@ -265,10 +406,12 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char *text)
 }
 
 // 解析请求头部的信息
-http_conn::HTTP_CODE http_conn::parse_headers(char *text)
+// ':' 的位置 已由请求头部扫描给出，得到字段名长度后 只和长度相同的已知字段名比较一次
+http_conn::HTTP_CODE http_conn::parse_headers(char *base, const http_line &line)
 {
     //遇到空行，表示请求头部字段解析完毕
-    if (text[0] == '\0')
+    char *text = base + line.begin;
+    if (line.end == line.begin)
     {
         // 如果HTTP请求有请求内容，还需要读取m_content_length字节的请求内容
         // 主状态机转移到 CHECK_STATE_CONTENT
@@ -280,115 +423,161 @@ http_conn::HTTP_CODE http_conn::parse_headers(char *text)
         // 否则 说明已经得到一个完整的HTTP请求
         return GET_REQUEST;
     }
-    else if (strncasecmp(text, "Connection:", 11) == 0)
+
+    char *end = base + line.end;
+    if (line.delim1 < 0)
+    {
+        return NO_REQUEST; // 没有 ':' 的行 忽略
+    }
+    char *colon = base + line.delim1;
+    int name_len = colon - text;
+    char *value = colon + 1;
+    value += strspn(value, " \t"); // 跳过 空格和\t
+
+    // 记录到头部表 (只保存指向读缓冲区的 string_view)。表满后跳过的头部 同样按 id 处理下面的字段
+    http_header h = header_table::make(text, name_len, value, end - value);
+    m_headers.add(h);
+    switch (h.id)
+    {
+    case HDR_CONNECTION:
     {
         // 处理 Connection 字段。  Connection:keep-alive
-        text += 11;
-        text += strspn(text, " \t"); // 跳过 空格和\t
-        if (strcasecmp(text, "keep-alive") == 0)
+        if (h.value.size() == 10 && strncasecmp(h.value.data(), "keep-alive", 10) == 0)
         {
             m_linger = true; // 保持连接
         }
+        break;
     }
-    else if (strncasecmp(text, "Content-Length:", 15) == 0)
+    case HDR_CONTENT_LENGTH:
     {
-        // 处理 Content-Length 字段。
-        text += 15;
-        text += strspn(text, " \t");
-        m_content_length = atol(text); // 将字符串 转长整型。
+        // 处理 Content-Length 字段。只接受十进制数字 (可带结尾空白)，且请求体不能超出读缓冲的最大长度：
+        // 负数或溢出的长度会使 m_checked_index 回退，越界访问读缓冲
+        if (value[0] < '0' || value[0] > '9')
+        {
+            return BAD_REQUEST;
+        }
+        errno = 0;
+        char *num_end;
+        long length = strtol(value, &num_end, 10);
+        num_end += strspn(num_end, " \t");
+        if (errno == ERANGE || *num_end != '\0' || length > (long)MAX_REQUEST_SIZE - m_checked_index)
+        {
+            return BAD_REQUEST;
+        }
+        // 重复的 Content-Length 必须相同，否则无法确定请求体的边界
+        if (m_content_length != 0 && m_content_length != length)
+        {
+            return BAD_REQUEST;
+        }
+        m_content_length = (int)length;
+        break;
     }
-    else if (strncasecmp(text, "Host:", 5) == 0)
+    case HDR_HOST:
     {
         // 处理 Host 字段。
-        text += 5;
-        text += strspn(text, " \t"); // 跳过 空格和\t
-        m_host = text;
+        m_host = value;
+        break;
     }
-    else
-    {
-        // printf("oop! unknow header.\n");
+    default:
+        break; // 其他头部 只记录，由后续功能按 id 查询
     }
     return NO_REQUEST; // 处理完头部 返回 NO_REQUEST 继续进行解析
 }
 
 // 解析请求体  只判断了 数据是否被读入
-http_conn::HTTP_CODE http_conn::parse_content(char *text)
+http_conn::HTTP_CODE http_conn::parse_content()
 {
     // 当前 读缓冲区下一个位置 大于 内容 + 当前检查字符 说明 content 被完整读入 读缓冲区
-    if (m_read_index >= (m_content_length + m_checked_index))
+    if ((long)m_read_index >= (long)m_content_length + m_checked_index)
     {
-        text[m_content_length] = '\0'; // 截断 content后面的内容
+        // 跳过请求体。不再写入 '\0' 截断，其后可能紧跟着下一个流水线请求
+        m_checked_index += m_content_length;
+        m_start_line = m_checked_index;
         return GET_REQUEST;
     }
     return NO_REQUEST;
 }
 
-// 主状态机 ： 解析HTTP请求
+// 主状态机 ： 解析HTTP请求，获得一个完整的客户请求后 调用 do_request
 http_conn::HTTP_CODE http_conn::process_read()
 {
-
-    LINE_STATUS line_status = LINE_OK; // 初始为LINE_OK
-    HTTP_CODE ret = NO_REQUEST;        // 初始为 NO_REQUEST
-
-    char *text = 0;
-
-    // 遍历所有 http 行
-    while ((m_check_state == CHECK_STATE_CONTENT) && (line_status == LINE_OK) ||
-           (line_status = parse_line()) == LINE_OK)
+    HTTP_CODE ret = parse_request();
+    if (ret == GET_REQUEST)
     {
-        // 情况1. 解析到了请求体，也是完整的数据。
-        // 情况2. 解析到了一行完整的数据。
-        // 操作. 获取一行数据
-        text = get_line();
-        m_start_line = m_checked_index; // 更新下一行首地址
-        // printf("got 1 http line: %s\n", text);
+        return do_request(); // 获得一个完整的客户请求，则去调用解析函数
+    }
+    return ret;
+}
 
-        // 主状态机
-        switch (m_check_state)
-        {
-        case CHECK_STATE_REQUESTLINE:
+// 解析当前请求。请求头部一次扫描 (http_scan_request) 得到各行的字段偏移，再按行处理：
+// 行结束符置为 '\0'，请求行与头部 直接使用扫描给出的分隔符位置，不再逐行重复扫描。
+// 数据不完整时 扫描状态保存在 m_scan 中，读入更多数据后 从上次停下的位置继续
+http_conn::HTTP_CODE http_conn::parse_request()
+{
+    http_line lines[SCAN_LINES];
+    while (m_check_state != CHECK_STATE_CONTENT)
+    {
+        char *base = m_read_buf + m_request_start;
+        int count = 0;
+        SCAN_STATUS status = http_scan_request(base, m_read_index - m_request_start, &m_scan, lines, SCAN_LINES, &count);
+        if (status == SCAN_BAD)
         {
-            ret = parse_request_line(text); // 解析请求首行
-            if (ret == BAD_REQUEST)
-            {
-                return BAD_REQUEST; // 语法错误直接结束
-            }
-            break;
+            return BAD_REQUEST; // 单独的 \r 或 \n
         }
-        case CHECK_STATE_HEADER:
+        for (int i = 0; i < count; ++i)
         {
-            ret = parse_headers(text); // 解析请求头部
-            if (ret == BAD_REQUEST)
+            const http_line &line = lines[i];
+            base[line.end] = '\0';                            // \r 置为字符串结束符。
+            base[line.end + 1] = '\0';                        // \n 置为字符串结束符。
+            m_checked_index = m_request_start + line.end + 2; // 下一行首地址
+            m_start_line = m_checked_index;
+
+            // 主状态机
+            HTTP_CODE ret;
+            if (m_check_state == CHECK_STATE_REQUESTLINE)
             {
-                return BAD_REQUEST; // 语法错误直接结束
+                ret = parse_request_line(base, line); // 解析请求首行
             }
-            else if (ret == GET_REQUEST)
+            else
             {
-                return do_request(); // 获得一个完整的客户请求，则去调用解析函数
+                ret = parse_headers(base, line); // 解析请求头部
             }
-            break;
-        }
-        case CHECK_STATE_CONTENT:
-        {
-            ret = parse_content(text); // 解析请求体
-            if (ret == GET_REQUEST)
+            if (ret != NO_REQUEST)
             {
-                return do_request(); // 获得一个完整的客户请求，则去调用解析函数
+                return ret; // 语法错误，或 获得一个完整的客户请求
             }
-            line_status = LINE_OPEN; // 未获得完整请求，置从状态为 LINE_OPEN（行数据不完整）
-            break;
         }
-        default:
-            return INTERNAL_ERROR;
+        if (status == SCAN_PARTIAL)
+        {
+            return NO_REQUEST; // 请求头部尚不完整
         }
     }
-    return NO_REQUEST;
+    return parse_content(); // 解析请求体
+}
+
+// 只解析 data 中的请求：拷贝到读缓冲后 走与服务器相同的 parse_request，不查找文件、不生成响应
+http_conn::HTTP_CODE http_conn::parse_only(const char *data, int len)
+{
+    if (m_read_buf == NULL)
+    {
+        m_read_index = 0;
+    }
+    if (len >= m_read_size && !grow_read_buf(len + 1))
+    {
+        return BAD_REQUEST; // 请求过大
+    }
+    memcpy(m_read_buf, data, len);
+    m_read_buf[len] = '\0';
+    m_read_index = len;
+    m_checked_index = 0;
+    init_request();
+    return parse_request();
 }
 
 // 解析请求 做出响应
 // 当得到一个完整正确的HTTP请求时候，我们需要分析目标文件的属性
-// 如果目标文件存在，对所有用户可读，且不是目录，则使用mmap将其
-// 映射到内存地址m_file_address处，并告诉调用者获取文件成功
+// 如果目标文件存在，对所有用户可读，且不是目录，则从 打开文件缓存 取得该文件
+// (fd、文件状态、mmap 方式下的映射地址、预先生成的响应头部)，并告诉调用者获取文件成功
 http_conn::HTTP_CODE http_conn::do_request()
 {
     // "home/devil/webserver/src"
@@ -396,43 +585,132 @@ http_conn::HTTP_CODE http_conn::do_request()
     int len = strlen(doc_root);
     strncpy(m_real_file + len, m_url, FILENAME_LEN - len - 1); // 把url拼接到目录下得到完整路径
 
-    // 获取m_real_file文件的相关的状态信息 传到m_file_stat参数， 返回值 -1失败 0成功
-    if (stat(m_real_file, &m_file_stat) < 0)
+    // 小文件 命中完整响应缓存时 不再访问文件。范围请求需要按文件生成响应，不查询完整响应缓存
+    bool ranged = m_headers.has(HDR_RANGE);
+    std::string_view accept = m_headers.get(HDR_ACCEPT_ENCODING);
+
+    // 动态压缩：客户端接受、且不是范围请求时 先查询压缩结果
+    int dynamic = -1;
+    if (!ranged && compress_cache::getInstance()->enabled())
     {
-        return NO_RESOURCE; // 不存在资源
+        dynamic = choose_encoding(accept, COMPRESS_ENCODINGS);
+    }
+    if (dynamic >= 0)
+    {
+        switch (compress_cache::getInstance()->acquire(m_real_file, dynamic, &m_cached))
+        {
+        case COMPRESS_HIT:
+            return check_not_modified(m_cached->etag, m_cached->st.st_mtime) ? NOT_MODIFIED : FILE_REQUEST;
+        case COMPRESS_SKIP:
+            dynamic = -1; // 不值得压缩，按未压缩发送
+            break;
+        default:
+            break;
+        }
     }
 
-    // 判断访问权限  读权限  S_IROTH
-    if (!(m_file_stat.st_mode & S_IROTH))
+    m_cached = ranged ? NULL : response_cache::getInstance()->acquire(m_real_file);
+    if (m_cached && ((m_cached->encodings && choose_encoding(accept, m_cached->encodings) >= 0) ||
+                     (dynamic >= 0 && m_cached->compressible && !m_cached->encodings)))
     {
-        return FORBIDDEN_REQUEST;
+        response_cache::release(m_cached); // 客户端接受压缩版本，缓存的是未压缩的响应
+        m_cached = NULL;
+    }
+    if (m_cached)
+    {
+        return check_not_modified(m_cached->etag, m_cached->st.st_mtime) ? NOT_MODIFIED : FILE_REQUEST;
     }
 
-    // 判断是否为目录
-    if (S_ISDIR(m_file_stat.st_mode))
+    // 命中打开文件缓存时 不再 stat/open/mmap/close
+    switch (file_cache::getInstance()->acquire(m_real_file, &m_file))
     {
-        return BAD_REQUEST;
+    case 0:
+        // 客户端接受的预压缩版本 (.br/.zst/.gz)，之后的条件请求、范围请求都针对该版本
+        if (m_file->encodings)
+        {
+            int encoding = choose_encoding(accept, m_file->encodings);
+            if (encoding >= 0)
+            {
+                m_file = file_cache::variant(m_file, encoding);
+            }
+        }
+        else if (dynamic >= 0)
+        {
+            // 没有预压缩文件时 动态压缩 (只压缩一次，结果缓存)
+            m_cached = compress_cache::getInstance()->compress(m_file, dynamic);
+            if (m_cached)
+            {
+                file_cache::release(m_file);
+                m_file = NULL;
+                return check_not_modified(m_cached->etag, m_cached->st.st_mtime) ? NOT_MODIFIED : FILE_REQUEST;
+            }
+        }
+        if (check_not_modified(m_file->etag, m_file->st.st_mtime))
+        {
+            return NOT_MODIFIED; // 客户端缓存有效，不发送文件
+        }
+        // 范围请求。If-Range 不成立 或 Range 无法识别时 发送整个文件
+        if (ranged && if_range_match(m_headers.get(HDR_IF_RANGE), m_file->etag, m_file->st.st_mtime))
+        {
+            switch (parse_range(m_headers.get(HDR_RANGE), m_file->st.st_size, m_ranges, &m_range_count))
+            {
+            case RANGE_OK:
+                return FILE_REQUEST;
+            case RANGE_UNSATISFIABLE:
+                return RANGE_NOT_SATISFIABLE;
+            default:
+                m_range_count = 0;
+                break;
+            }
+        }
+        response_cache::getInstance()->admit(m_file); // 按访问频率 决定是否缓存完整响应 (只缓存未压缩的)
+        return FILE_REQUEST; // 获取资源文件成功
+    case ENOENT:
+        return NO_RESOURCE; // 不存在资源
+    case EACCES:
+        return FORBIDDEN_REQUEST; // 没有读权限
+    case EISDIR:
+        return BAD_REQUEST; // 目录
+    default:
+        return INTERNAL_ERROR;
     }
+}
 
-    // 以只读方式打开资源文件
-    int fd = open(m_real_file, O_RDONLY);
-    // 内存映射  只读， 写入时，会产生映射文件的拷贝
-    m_file_addr = (char *)mmap(0, m_file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    close(fd);           // 关闭fd
-    return FILE_REQUEST; // 获取资源文件成功
+// 条件请求：If-None-Match 与实体标签匹配，或 (没有 If-None-Match 时) 文件在 If-Modified-Since 之后未修改
+bool http_conn::check_not_modified(const char *etag, time_t mtime)
+{
+    return not_modified(m_headers.get(HDR_IF_NONE_MATCH), m_headers.get(HDR_IF_MODIFIED_SINCE), etag, mtime);
 }
 
-// 对内存映射区 进行一个 释放, 执行 unmap()
+// 释放 本批响应 引用的缓存文件与缓存响应。最后一个引用释放时 缓存才真正关闭 fd、解除映射
 void http_conn::unmap()
 {
-    if (m_file_addr)
+    if (m_file)
+    {
+        file_cache::release(m_file);
+        m_file = NULL;
+    }
+    if (m_cached)
+    {
+        response_cache::release(m_cached);
+        m_cached = NULL;
+    }
+    for (int i = 0; i < m_resp_count; ++i)
     {
-        munmap(m_file_addr, m_file_stat.st_size);
-        m_file_addr = 0;
+        if (m_resp[i].file)
+        {
+            file_cache::release(m_resp[i].file);
+            m_resp[i].file = NULL;
+        }
+        if (m_resp[i].cached)
+        {
+            response_cache::release(m_resp[i].cached);
+            m_resp[i].cached = NULL;
+        }
     }
 }
 
-// 写HTTP响应  一次性写入所有 sockfd 数据。写完 返回真
+// 写HTTP响应  一次性写入本批所有响应。写完 返回真
 bool http_conn::write()
 {
     int temp = 0;
@@ -448,8 +726,70 @@ bool http_conn::write()
     // 循环 写数据到sockfd
     while (true)
     {
-        // writev 分散写  从 m_iv指定的多块内存中写数据到 sockfd
-        temp = writev(m_sockfd, m_iv, m_iv_count);
+        bool file_block = m_iv[m_iv_index].iov_base == NULL;
+        if (file_block)
+        {
+            // 文件块：sendfile 由内核直接从页缓存发送到 socket，文件偏移由 sendfile 更新。
+            // 每次最多发送一个窗口，窗口不在页缓存中时 交给 I/O 线程预读，事件循环不阻塞在磁盘上
+            int fd = m_iv_fd[m_iv_index];
+            size_t len = m_iv[m_iv_index].iov_len < IO_WINDOW ? m_iv[m_iv_index].iov_len : IO_WINDOW;
+            if (m_iv_probe[m_iv_index] && !io_reader::resident(fd, m_iv_offset[m_iv_index], len) &&
+                wait_io(fd, m_iv_offset[m_iv_index], len))
+            {
+                return true;
+            }
+            temp = sendfile(m_sockfd, fd, &m_iv_offset[m_iv_index], len);
+        }
+        else
+        {
+            // 内存块：分散写 到下一个文件块之前的所有内存块。后面还有文件块时带 MSG_MORE，
+            // 使响应头部与随后 sendfile 的文件内容合并为满载的报文段
+            int end = m_iv_index + 1;
+            while (end < m_iv_count && m_iv[end].iov_base != NULL)
+            {
+                ++end;
+            }
+            // 已映射的文件块 先检查是否在页缓存中，避免 sendmsg 在缺页时阻塞。
+            // 检查只覆盖一个窗口，超过窗口的块 本次只发送这个窗口，并截止于该块，与 sendfile 分支相同
+            int capped = -1;
+            for (int i = m_iv_index; i < end; ++i)
+            {
+                if (m_iv_fd[i] < 0 || !m_iv_probe[i])
+                {
+                    continue;
+                }
+                if (!io_reader::resident((char *)m_iv[i].iov_base, m_iv[i].iov_len) &&
+                    wait_io(m_iv_fd[i], m_iv_offset[i], m_iv[i].iov_len))
+                {
+                    return true;
+                }
+                if (m_iv[i].iov_len > IO_WINDOW)
+                {
+                    capped = i;
+                    end = i + 1;
+                    break;
+                }
+            }
+            size_t capped_len = capped >= 0 ? m_iv[capped].iov_len : 0;
+            if (capped >= 0)
+            {
+                m_iv[capped].iov_len = IO_WINDOW;
+            }
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = m_iv + m_iv_index;
+            msg.msg_iovlen = end - m_iv_index;
+            temp = sendmsg(m_sockfd, &msg, end < m_iv_count || capped >= 0 ? MSG_MORE : 0);
+            if (capped >= 0)
+            {
+                m_iv[capped].iov_len = capped_len; // 恢复完整长度，下面按实际发送的字节数推进
+            }
+        }
+        if (temp == 0 && file_block)
+        {
+            unmap(); // 文件在发送过程中被截断
+            return false;
+        }
         if (temp <= -1)
         {
             // 如果TCP写缓冲没有空间，则等待下一轮的EPOLLOUT事件，
@@ -465,44 +805,66 @@ bool http_conn::write()
         bytes_have_send += temp; // 已发送字节数更新
         bytes_to_send -= temp;   // 待发送字节数更新
 
-        // 如果当前 第一块数据区发送完毕 更新 m_iv 资源块数据
-        if (bytes_have_send >= m_iv[0].iov_len)
+        // 跳过 已发送完的内存块，更新 部分发送的内存块
+        if (file_block)
         {
-            m_iv[0].iov_len = 0;
-            // 更新第二块数据块 基址  // 已发送字节减去第一块数据长度  m_wirte_index 即为 响应首行+响应头部
-            m_iv[1].iov_base = m_file_addr + (bytes_have_send - m_write_index);
-            m_iv[1].iov_len = bytes_to_send; // 剩余待发送字节为 当前 数据区长度
+            m_iv[m_iv_index].iov_len -= temp;
+            if (m_iv[m_iv_index].iov_len == 0)
+            {
+                ++m_iv_index;
+            }
+            temp = 0;
         }
-        else
+        while (m_iv_index < m_iv_count && m_iv[m_iv_index].iov_base != NULL && (size_t)temp >= m_iv[m_iv_index].iov_len)
+        {
+            temp -= m_iv[m_iv_index].iov_len;
+            ++m_iv_index;
+        }
+        if (m_iv_index < m_iv_count && temp > 0)
         {
-            // 第一块数据还没有读取完毕， 更新第一块数据
-            m_iv[0].iov_base = m_write_buf + bytes_have_send;
-            m_iv[0].iov_len = m_iv[0].iov_len - temp;
+            m_iv[m_iv_index].iov_base = (char *)m_iv[m_iv_index].iov_base + temp;
+            m_iv[m_iv_index].iov_len -= temp;
+            m_iv_offset[m_iv_index] += temp;
         }
 
         if (bytes_to_send <= 0)
         {
             // 写数据完毕  ，释放内存映射
             unmap();
-            modifyfd(m_epfd, m_sockfd, EPOLLIN); // 修改 epoll 对象属性
-            if (m_linger)
-            {
-                init(); // 如果连接 保持，则初始化链接，用于下次使用
-                return true;
-            }
-            else
+            if (!m_keep_alive)
             {
                 printf("-----------------------------------断开连接\n");
                 return false;
             }
+            // 连接保持。读缓冲中还有可处理的请求 由事件循环再次交给线程池，否则等待下次读事件
+            finish_response();
+            if (!m_pending)
+            {
+                modifyfd(m_epfd, m_sockfd, EPOLLIN); // 修改 epoll 对象属性
+            }
+            return true;
         }
     }
 }
 
+// 文件区间不在页缓存中：递增预读序号、标记等待，再提交给 I/O 线程 (完成时 I/O 线程可能立即重新注册 EPOLLOUT)。
+// 提交失败时 清除标记，由调用者直接发送
+bool http_conn::wait_io(int fd, off_t offset, size_t len)
+{
+    ++m_io_seq;
+    m_io_wait.store(true);
+    if (io_reader::getInstance()->submit(this, fd, offset, len))
+    {
+        return true;
+    }
+    m_io_wait.store(false);
+    return false;
+}
+
 // 向写缓冲区写入待发送的数据
 bool http_conn::add_response(const char *format, ...)
 {
-    if (m_write_index >= WRITE_BUF_SIZE)
+    if (m_write_index >= m_write_size)
     {
         return false; // 写缓冲溢出
     }
@@ -510,8 +872,8 @@ bool http_conn::add_response(const char *format, ...)
     va_list arg_list;
     va_start(arg_list, format); // 可变参数列表
     // 写入 写缓冲
-    int len = vsnprintf(m_write_buf + m_write_index, WRITE_BUF_SIZE - 1 - m_write_index, format, arg_list);
-    if (len >= (WRITE_BUF_SIZE - 1 - m_write_index))
+    int len = vsnprintf(m_write_buf + m_write_index, m_write_size - 1 - m_write_index, format, arg_list);
+    if (len >= (m_write_size - 1 - m_write_index))
     {
         return false; // 数据过多 写溢出。
     }
@@ -520,6 +882,18 @@ bool http_conn::add_response(const char *format, ...)
     return true;
 }
 
+// 向写缓冲区写入 len 字节的已生成内容
+bool http_conn::add_raw(const char *data, int len)
+{
+    if (len >= m_write_size - 1 - m_write_index)
+    {
+        return false; // 写缓冲溢出
+    }
+    memcpy(m_write_buf + m_write_index, data, len);
+    m_write_index += len;
+    return true;
+}
+
 // 添加 响应 请求首行
 bool http_conn::add_status_line(int status, const char *title)
 {
@@ -548,6 +922,20 @@ bool http_conn::add_content_type()
     return add_response("Content-Type:%s\r\n", "text/html");
 }
 
+// 添加响应头部信息 : Content-Encoding (预压缩版本)、Vary (有压缩版本时)、Last-Modified、ETag
+bool http_conn::add_entity_headers(const file_entry *file)
+{
+    if (file->encoding >= 0)
+    {
+        add_response("Content-Encoding: %s\r\n", encoding_names[file->encoding]);
+    }
+    if (file->encoding >= 0 || file->encodings != 0 || file->compressible)
+    {
+        add_response("%s", "Vary: Accept-Encoding\r\n");
+    }
+    return add_response("Last-Modified: %s\r\nETag: %s\r\n", file->last_modified, file->etag);
+}
+
 // 添加响应头部信息 : Connection
 bool http_conn::add_linger()
 {
@@ -566,10 +954,101 @@ bool http_conn::add_content(const char *content)
     return add_response("%s", content);
 }
 
+// 当前响应追加一个片段：写缓冲中 [head, m_write_index) 的内容，其后发送文件的 [offset, offset + size)
+void http_conn::add_segment(int head, off_t offset, size_t size)
+{
+    segment &seg = m_seg[m_seg_count++];
+    seg.head = head;
+    seg.head_len = m_write_index - head;
+    seg.offset = offset;
+    seg.size = size;
+    ++m_resp[m_resp_count].seg_count;
+    bytes_to_send += seg.head_len + size; // 待发送数据总大小
+}
+
+// 添加文件响应。没有范围时为 200 + 整个文件；一个范围为 206 + 该范围；
+// 多个范围为 206 multipart/byteranges，每个范围前有 分隔符 + Content-Type + Content-Range
+bool http_conn::add_file_response()
+{
+    const file_entry *f = m_file;
+    long long size = f->st.st_size;
+    int head = m_write_index;
+
+    if (m_range_count == 0)
+    {
+        // 响应首行、Content-Length、Content-Type、Last-Modified、ETag 使用缓存中预先生成的头部
+        if (!add_raw(f->header, f->header_len) || !add_linger() || !add_blank_line())
+        {
+            return false;
+        }
+        add_segment(head, 0, size);
+        return true;
+    }
+
+    add_status_line(206, partial_206_title);
+    if (m_range_count == 1)
+    {
+        const byte_range &r = m_ranges[0];
+        add_content_length(r.last - r.first + 1);
+        add_response("Content-Type:%s\r\n", f->content_type);
+        add_response("Content-Range: bytes %lld-%lld/%lld\r\n", (long long)r.first, (long long)r.last, size);
+        add_entity_headers(f);
+        add_linger();
+        if (!add_blank_line())
+        {
+            return false;
+        }
+        add_segment(head, r.first, r.last - r.first + 1);
+        return true;
+    }
+
+    // 多范围：先计算响应体长度 (各分隔头部 + 各范围 + 结束分隔符)
+    static const char part_format[] = "\r\n--%010u\r\nContent-Type: %s\r\nContent-Range: bytes %lld-%lld/%lld\r\n\r\n";
+    static const char end_format[] = "\r\n--%010u--\r\n";
+    unsigned boundary = s_boundary.fetch_add(1, std::memory_order_relaxed);
+    long long content_len = snprintf(NULL, 0, end_format, boundary);
+    for (int i = 0; i < m_range_count; ++i)
+    {
+        const byte_range &r = m_ranges[i];
+        content_len += snprintf(NULL, 0, part_format, boundary, f->content_type, (long long)r.first,
+                                (long long)r.last, size);
+        content_len += r.last - r.first + 1;
+    }
+    add_response("Content-Length: %lld\r\n", content_len);
+    add_response("Content-Type: multipart/byteranges; boundary=%010u\r\n", boundary);
+    add_entity_headers(f);
+    add_linger();
+    add_blank_line();
+
+    // 响应头部与第一个分隔头部 在写缓冲中相邻，合为一个片段
+    for (int i = 0; i < m_range_count; ++i)
+    {
+        const byte_range &r = m_ranges[i];
+        if (!add_response(part_format, boundary, f->content_type, (long long)r.first, (long long)r.last, size))
+        {
+            return false;
+        }
+        add_segment(head, r.first, r.last - r.first + 1);
+        head = m_write_index;
+    }
+    if (!add_response(end_format, boundary))
+    {
+        return false;
+    }
+    add_segment(head, 0, 0);
+    return true;
+}
+
 // 根据服务器解析HTTP请求的结果，决定生成响应给客户的内容
 bool http_conn::process_write(HTTP_CODE read_ret)
 {
     // printf("read_ret:%d\n", read_ret);
+    response &resp = m_resp[m_resp_count];
+    int head = m_write_index; // 本响应 在写缓冲中的起始地址
+    resp.file = NULL;
+    resp.cached = NULL;
+    resp.seg = m_seg_count;
+    resp.seg_count = 0;
     switch (read_ret)
     {
         // 内部错误
@@ -615,55 +1094,199 @@ bool http_conn::process_write(HTTP_CODE read_ret)
             return false;
         }
         break;
+    }
+        // 客户端缓存有效 / 范围不可满足：只有 响应首行 + 头部，不带响应体
+    case NOT_MODIFIED:
+    case RANGE_NOT_SATISFIABLE:
+    {
+        if (read_ret == NOT_MODIFIED)
+        {
+            add_status_line(304, not_modified_304_title);
+            if (m_cached)
+            {
+                if (m_cached->encodings || m_cached->compressible)
+                {
+                    add_response("%s", "Vary: Accept-Encoding\r\n");
+                }
+                add_response("Last-Modified: %s\r\nETag: %s\r\n", m_cached->last_modified, m_cached->etag);
+            }
+            else
+            {
+                add_entity_headers(m_file);
+            }
+        }
+        else
+        {
+            add_status_line(416, error_416_title);
+            add_response("Content-Range: bytes */%lld\r\n", (long long)m_file->st.st_size);
+            add_content_length(0);
+        }
+        add_linger();
+        if (!add_blank_line())
+        {
+            return false;
+        }
+        // 不再需要文件，释放本请求的引用 (本批之前的响应仍在等待发送)
+        if (m_file)
+        {
+            file_cache::release(m_file);
+            m_file = NULL;
+        }
+        if (m_cached)
+        {
+            response_cache::release(m_cached);
+            m_cached = NULL;
+        }
+        break;
     }
         // 获取资源文件成功
     case FILE_REQUEST:
     {
-        add_status_line(200, ok_200_title);
-        add_headers(m_file_stat.st_size);
-
-        // 更新 写数据src资源块信息  [请求首行 + 请求头部, 请求体], 等待 写就绪事件
-        m_iv[0].iov_base = m_write_buf;
-        m_iv[0].iov_len = m_write_index;
-        m_iv[1].iov_base = m_file_addr;
-        m_iv[1].iov_len = m_file_stat.st_size;
-        m_iv_count = 2;
+        // 命中完整响应缓存：不生成头部，直接发送缓存的内存块
+        if (m_cached)
+        {
+            resp.cached = m_cached;
+            resp.linger = m_linger;
+            m_cached = NULL;
+            bytes_to_send += resp.linger ? resp.cached->len
+                                         : resp.cached->close_head_len + resp.cached->len - resp.cached->head_len;
+            ++m_resp_count;
+            return true;
+        }
 
-        bytes_to_send = m_write_index + m_file_stat.st_size; // 待发送数据总大小为两部分之和
+        // 记录 写数据src资源块信息  [请求首行 + 请求头部, 请求体]，文件交由本批响应管理
+        if (!add_file_response())
+        {
+            return false;
+        }
+        resp.file = m_file;
+        m_file = NULL;
+        ++m_resp_count;
         return true;
     }
     default:
         return false;
     }
-    // 内部错误，错误请求，资源不存在，禁止访问。都会转到 这里。设置 m_iv 为 write_buf。写回内容 只有 响应首行 + 响应头部
-    m_iv[0].iov_base = m_write_buf;
-    m_iv[0].iov_len = m_write_index;
-    m_iv_count = 1;
-    bytes_to_send = m_write_index;
+    // 内部错误，错误请求，资源不存在，禁止访问 等的写回内容 只有 响应首行 + 响应头部 (+ 错误页)
+    add_segment(head, 0, 0);
+    ++m_resp_count;
     return true;
 }
 
 // 工作函数 : 处理客户端请求入口函数，由线程池中的工作线程调用。
+// 读缓冲中的流水线请求 依次解析并生成响应，合并为一次 writev。每次最多处理 MAX_PIPELINE 个，避免独占工作线程
 void http_conn::process()
 {
-    // printf("正在处理http请求>>>\n");
-    // 解析http请求
-    HTTP_CODE read_ret = process_read();
-    if (read_ret == NO_REQUEST)
+    // 上报排队时延，供过载控制判断是否需要拒绝新请求
+    time_t now = ulist_timer::now_ms();
+    overload::getInstance()->on_dequeue(now - m_queue_time, now);
+
+    m_pending = false;
+    while (true)
+    {
+        // 写缓冲 至少为下一个响应预留 WRITE_BUF_SIZE
+        if (m_write_size - m_write_index < WRITE_BUF_SIZE && !grow_write_buf(m_write_index + WRITE_BUF_SIZE))
+        {
+            m_pending = true; // 写缓冲已达上限，剩余请求 下一批处理
+            break;
+        }
+
+        // printf("正在处理http请求>>>\n");
+        // 解析http请求
+        HTTP_CODE read_ret = process_read();
+        if (read_ret == NO_REQUEST)
+        {
+            break; // 客户数据不足，剩余数据 待下次读取后继续解析
+        }
+        if (read_ret == BAD_REQUEST)
+        {
+            m_linger = false; // 请求格式错误，无法确定下一个请求的边界，响应后关闭连接
+        }
+
+        // printf("正在生成http响应>>>\n");
+        // 生成http响应
+        if (!process_write(read_ret))
+        {
+            printf("生成响应失败\n");
+            unmap();
+            this->m_timer->func(this);
+            return;
+        }
+        m_keep_alive = m_linger;
+        if (!m_linger)
+        {
+            break; // 不保持连接，之后的数据不再处理
+        }
+        init_request(); // 下一个请求 从当前请求结束处开始
+        if (m_resp_count == MAX_PIPELINE || m_seg_count + MAX_RANGES + 1 > MAX_SEGMENTS)
+        {
+            m_pending = true; // 达到合并上限，剩余请求 下一批处理
+            break;
+        }
+    }
+
+    if (m_resp_count == 0)
     {                                        // 如果客户数据不足，继续接受数据
         modifyfd(m_epfd, m_sockfd, EPOLLIN); // 修改epoll通知获取数据, 继续进行读取数据
         return;                              // 结束处理 程序
     }
 
-    // printf("正在生成http响应>>>\n");
-    // 生成http响应
-    bool write_ret = process_write(read_ret);
-    if (!write_ret)
+    // 本批所有响应的内存块。写缓冲已不再增长，此时才能确定其地址；相邻的写缓冲内容合并为一块
+    m_iv_count = 0;
+    m_iv_index = 0;
+    for (int i = 0; i < m_resp_count; ++i)
     {
-        printf("生成响应失败\n");
-        // m_timer->expire = 9527; // 准备关闭链接。过期时间置0
-        this->m_timer->func(this);
-        // close_conn();
+        const response &resp = m_resp[i];
+        if (resp.cached)
+        {
+            // 完整响应缓存：保持连接时为一整块，否则为 Connection: close 头部 + 响应体 两块
+            const cached_response *c = resp.cached;
+            if (resp.linger)
+            {
+                m_iv[m_iv_count].iov_base = c->data;
+                m_iv_fd[m_iv_count] = -1;
+                m_iv[m_iv_count++].iov_len = c->len;
+            }
+            else
+            {
+                m_iv[m_iv_count].iov_base = (char *)c->close_head;
+                m_iv_fd[m_iv_count] = -1;
+                m_iv[m_iv_count++].iov_len = c->close_head_len;
+                m_iv[m_iv_count].iov_base = c->data + c->head_len;
+                m_iv_fd[m_iv_count] = -1;
+                m_iv[m_iv_count++].iov_len = c->len - c->head_len;
+            }
+            continue;
+        }
+        char *addr = resp.file ? resp.file->addr.load(std::memory_order_acquire) : NULL; // 热点文件可能在其他线程中被映射
+        bool probe = resp.file && !file_cache::getInstance()->hot(resp.file);          // 热点文件 认为在页缓存中
+        for (int j = resp.seg; j < resp.seg + resp.seg_count; ++j)
+        {
+            const segment &seg = m_seg[j];
+            char *head = m_write_buf + seg.head;
+            if (seg.head_len > 0)
+            {
+                if (m_iv_count > 0 && (char *)m_iv[m_iv_count - 1].iov_base + m_iv[m_iv_count - 1].iov_len == head)
+                {
+                    m_iv[m_iv_count - 1].iov_len += seg.head_len;
+                }
+                else
+                {
+                    m_iv[m_iv_count].iov_base = head;
+                    m_iv_fd[m_iv_count] = -1;
+                    m_iv[m_iv_count++].iov_len = seg.head_len;
+                }
+            }
+            if (seg.size > 0)
+            {
+                // 不在内存中的文件 (sendfile 方式) 其文件块 iov_base 为 NULL，发送时从 fd 的 offset 处读取
+                m_iv[m_iv_count].iov_base = addr ? addr + seg.offset : NULL;
+                m_iv[m_iv_count].iov_len = seg.size;
+                m_iv_fd[m_iv_count] = resp.file->fd;
+                m_iv_probe[m_iv_count] = probe;
+                m_iv_offset[m_iv_count++] = seg.offset;
+            }
+        }
     }
     modifyfd(m_epfd, m_sockfd, EPOLLOUT); // 生成响应完毕，写入 epoll 对象，通知 EPOLLOUT
 }
@@ -684,23 +1307,17 @@ void http_conn::setTimer(http_conn *user, void(func)(http_conn *), time_t slot)
         m_timer = new ulist_timer();
     }
     m_timer->user_data = user;
-    m_timer->func = back_func;
+    m_timer->func = func;
 
-    time_t expire = m_timer->getExpireTime(slot);
-    // printf("当前节点到期时间：%ld\n", expire);
-    m_timer->expire = expire;
+    // 以事件循环本轮缓存的时间为基准，无需再次读取时钟
+    m_timer->expire = m_timer_wheel->now() + 1000 * slot;
     if (flag)
     {
-        // http_conn::timer_lst->showList();
-        // printf("调用添加之后\n");
-        http_conn::timer_lst->add_timer(m_timer);
-        // http_conn::timer_lst->showList();
+        m_timer_wheel->add_timer(m_timer);
     }
     else
     {
-        // printf("调用修改之后\n");
-        http_conn::timer_lst->update_timer(m_timer);
-        // http_conn::timer_lst->showList();
+        m_timer_wheel->update_timer(m_timer);
     }
     // printf("当前客户端到期时间：%ld\n", m_timer->expire);
 }
\ No newline at end of file
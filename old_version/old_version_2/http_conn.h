@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <sys/epoll.h>
 #include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -20,6 +21,14 @@
 #include <sys/time.h>
 #include <time.h>
 
+#include <atomic>
+
+#include "file_cache.h"
+#include "http_cond.h"
+#include "http_header.h"
+#include "http_range.h"
+#include "http_scan.h"
+#include "response_cache.h"
 #include "locker.h"
 
 /*
@@ -32,6 +41,7 @@
 
 class ulist_timer;
 class timer_list;
+class timer_wheel;
 
 // http 连接请求 任务类
 class http_conn
@@ -40,19 +50,30 @@ class http_conn
     friend void back_func(http_conn *);
 
 public:
-    static int pipefd[2];         // 传递 alarm 信号管道。pipe[1] 用于写,pipe[0] 用于读
-    static timer_list *timer_lst; // http对象 任务链表
-    ulist_timer *m_timer;         // 每个 users 独有
+    timer_wheel *m_timer_wheel; // 所属事件循环的 定时器时间轮
+    ulist_timer *m_timer;       // 每个 users 独有
 
 public:
-    // http 任务类共享 epfd属性
-    static int m_epfd;      // 所有socket事件都被注册到同一个epoll对象中
-    static int m_user_size; // 统计当前用户数量
+    int m_epfd;                         // 所属事件循环的 epoll 对象，socket事件只注册到该对象中
+    static std::atomic<int> m_user_size; // 统计当前用户数量（所有事件循环共享）
 
     // 静态常量类成员变量 可以在类内初始化
-    static const int READ_BUF_SIZE = 2048;  // 读缓冲最大容量
-    static const int WRITE_BUF_SIZE = 2048; // 写缓冲最大容量
+    static const int MAX_REQUEST_SIZE = 65536; // 单个请求的最大字节数，读缓冲按需增长到该大小
+    static const int READ_SPILL_SIZE = 65536;  // readv 的栈上溢出区大小
+    static const int WRITE_BUF_SIZE = 2048;    // 单个响应 首行+头部 的最大长度
+    static const int MAX_PIPELINE = 16;        // 每次处理最多合并的流水线请求数 (公平性上限)
+    static const int MAX_SEGMENTS = 2 * MAX_PIPELINE + MAX_RANGES; // 本批响应最多的片段数 (多范围响应每个范围一个片段)
     static const int FILENAME_LEN = 200;    // 文件名的最大长度
+    static const int SCAN_LINES = 32;       // 每次扫描请求头部 最多返回的行数
+
+    // 文件响应体的发送方式
+    enum SEND_MODE
+    {
+        SEND_MMAP = 0, // mmap 映射后与头部一起 writev
+        SEND_SENDFILE, // 头部 sendmsg(MSG_MORE)，响应体 sendfile 零拷贝
+        SEND_AUTO      // 按文件大小与热度 选择 读入内存 / mmap / sendfile (io_strategy.h)
+    };
+    static int m_send_mode; // 文件发送方式 (所有连接共享，启动时设置)
 
     // HTTP请求方法，这里只支持GET
     enum METHOD
@@ -88,6 +109,8 @@ public:
         NO_RESOURCE         :   表示服务器没有资源
         FORBIDDEN_REQUEST   :   表示客户对资源没有足够的访问权限
         FILE_REQUEST        :   文件请求,获取文件成功
+        NOT_MODIFIED        :   条件请求,客户端缓存的副本仍然有效
+        RANGE_NOT_SATISFIABLE : 范围请求,所有范围都超出文件大小
         INTERNAL_ERROR      :   表示服务器内部错误
         CLOSED_CONNECTION   :   表示客户端已经关闭连接了
     */
@@ -99,72 +122,91 @@ public:
         NO_RESOURCE,
         FORBIDDEN_REQUEST,
         FILE_REQUEST,
+        NOT_MODIFIED,
+        RANGE_NOT_SATISFIABLE,
         INTERNAL_ERROR,
         CLOSED_CONNECTION
     };
 
-    // 从状态机的三种可能状态，即行的读取状态，分别表示
-    // 1.读取到一个完整的行 2.行出错 3.行数据尚且不完整
-    enum LINE_STATUS
-    {
-        LINE_OK = 0,
-        LINE_BAD,
-        LINE_OPEN
-    };
-
 public:
-    http_conn() : m_sockfd(-1), m_timer(nullptr) {} // 构造函数
+    http_conn() : m_timer_wheel(nullptr), m_timer(nullptr), m_epfd(-1), m_sockfd(-1), m_io_wait(false), m_io_seq(0),
+                  m_read_buf(NULL), m_read_size(0), m_write_buf(NULL), m_write_size(0) {} // 构造函数
     ~http_conn() {}                                 // 析构函数
 
 public:
-    void init(int sockfd, const sockaddr_in &addr); // 初始化新接收的 用户连接任务请求
-    void close_conn();                              // 销毁 通信连接任务。
-    void process();                                 // 工作函数 : 处理客户端请求
-    bool read();                                    // 读完 返回真 （非阻塞读；
-    bool write();                                   // 写完 返回真 （非阻塞写
+    void init(int sockfd, const sockaddr_in &addr, int epfd, timer_wheel *timer_wheel); // 初始化新接收的 用户连接任务请求
+    void close_conn();                                                                  // 销毁 通信连接任务。
+    void process();                                                                     // 工作函数 : 处理客户端请求
+    bool read();                                                                        // 读完 返回真 （非阻塞读；
+    bool write();                                                                       // 写完 返回真 （非阻塞写
+    bool pending() const { return m_pending && bytes_to_send == 0; }                    // 本批响应已写完，且读缓冲中还有待处理的流水线请求
+
+    // 只解析 data 中的请求 (不查找文件、不生成响应)，供解析基准测试 使用与服务器相同的解析路径
+    HTTP_CODE parse_only(const char *data, int len);
+    const header_table &headers() const { return m_headers; } // 请求头部表
 
 private:
     void init();                            // 初始化连接  分析请求相关信息
-    HTTP_CODE process_read();               // 解析HTTP请求报文
+    void init_request();                    // 初始化 下一个请求的解析状态，保留读缓冲中剩余的数据
+    void finish_response();                 // 一批响应发送完毕，整理读缓冲中剩余的流水线数据
+    HTTP_CODE process_read();               // 解析HTTP请求报文，请求完整时 调用 do_request
+    HTTP_CODE parse_request();              // 解析当前请求，直到头部与请求体完整
     bool process_write(HTTP_CODE read_ret); // 生成HTTP响应报文
 
     // 这一组函数被process_read调用以分析HTTP请求
-    HTTP_CODE parse_request_line(char *text);              // 解析请求首行
-    HTTP_CODE parse_headers(char *text);                   // 解析请求头部
-    HTTP_CODE parse_content(char *text);                   // 解析请求体
-    HTTP_CODE do_request();                                // 解析请求
-    char *get_line() { return m_read_buf + m_start_line; } // 获取一行数据 返回该行指针即可。
-    LINE_STATUS parse_line();                              // 具体解析某一行
+    // base 为当前请求的起始地址，line 为扫描得到的该行字段偏移 (相对于 base)
+    HTTP_CODE parse_request_line(char *base, const http_line &line); // 解析请求首行
+    HTTP_CODE parse_headers(char *base, const http_line &line);      // 解析请求头部
+    HTTP_CODE parse_content();                                       // 解析请求体
+    HTTP_CODE do_request();                                          // 解析请求
+    bool check_not_modified(const char *etag, time_t mtime);         // 条件请求：客户端缓存的副本是否仍然有效
 
     // 这一组函数被process_write调用以生成HTTP响应
     bool add_status_line(int status, const char *title); // 添加 响应 请求首行
     bool add_response(const char *format, ...);          // 向写缓冲区写入待发送的数据
+    bool add_raw(const char *data, int len);             // 向写缓冲区写入 已生成的内容
     bool add_headers(int content_len);                   // 添加响应 请求头部
     bool add_content_length(int content_len);            // 添加响应头部信息 : content-length
     bool add_content_type();                             // 添加响应头部信息 : Content-Type
     bool add_linger();                                   // 添加响应头部信息 : Connection:keep-alive
     bool add_blank_line();                               // 添加响应头部信息 : 空行
     bool add_content(const char *content);               // 添加响应体内容
-    void unmap();                                        // 释放 目标资源文件内存映射
+    bool add_file_response();                            // 添加文件响应：200 整个文件，或 206 单范围/多范围
+    bool add_entity_headers(const file_entry *file);     // 添加响应头部信息 : Content-Encoding、Vary、Last-Modified、ETag
+    void add_segment(int head, off_t offset, size_t size); // 当前响应追加一个片段：写缓冲 [head, m_write_index) + 文件范围
+    void unmap();                                        // 释放 本批响应 引用的缓存文件
+    bool wait_io(int fd, off_t offset, size_t len);      // 文件区间不在页缓存中：交给 I/O 线程预读，完成后再继续发送
+
+    // 缓冲区从 buffer_pool 按需申请，空闲连接不持有缓冲区
+    bool grow_read_buf(int size);                            // 读缓冲 增长到不小于 size 字节，并重新定位已解析的指针
+    bool grow_write_buf(int size);                           // 写缓冲 增长到不小于 size 字节
+    void rebase_read_buf(const char *old_base, char *new_base); // 读缓冲数据移动后，重新定位已解析的指针
+    void release_buffers();                                  // 归还 读/写缓冲
 
 public:
     void getClientIp(char *);
 
-    // 设置当前 http 任务定时器
+    // 设置当前 http 任务定时器，slot 秒后到期
     void setTimer(http_conn *user, void(func)(http_conn *), time_t slot);
 
 public:
-    int m_sockfd; // http 任务对象的socket
+    int m_sockfd;        // http 任务对象的socket
+    time_t m_queue_time; // 加入线程池请求队列的时间 (毫秒)，用于计算排队时延
+    std::atomic<bool> m_io_wait; // 正在等待 I/O 线程预读 (由 io_reader 在其锁内清除)
+    std::atomic<unsigned> m_io_seq; // 预读序号：每次提交预读前递增，连接关闭后也不重置
 
 private:
     // 分配的资源
     // int m_sockfd;       // http 任务对象的socket
     sockaddr_in m_addr; // 通信的socket地址
 
-    char m_read_buf[READ_BUF_SIZE]; // 读缓冲
+    char *m_read_buf;               // 读缓冲 (来自 buffer_pool，无数据时为 NULL)
+    int m_read_size;                // 读缓冲容量
     int m_read_index;               // 当前读缓冲光标地址
+    int m_request_start;            // 当前请求在读缓冲中的起始地址
     int m_checked_index;            // 当前需要解析的字符地址
     int m_start_line;               // 当前需要解析的请求行的首地址
+    http_scan_state m_scan;         // 请求头部的扫描状态 (偏移相对于 m_request_start)
 
     CHECK_STATE m_check_state; // 主状态机当前状态
     METHOD m_method;           // 请求方法
@@ -175,13 +217,46 @@ private:
     char *m_host;                   // 主机名
     int m_content_length;           // 请求体字节大小
     bool m_linger;                  // http是否保持连接
+    header_table m_headers;         // 请求头部表 (指向读缓冲区)
+    byte_range m_ranges[MAX_RANGES]; // 请求的字节范围
+    int m_range_count;              // 范围数量，0 表示发送整个文件
 
-    char m_write_buf[WRITE_BUF_SIZE]; // 写缓冲
+    char *m_write_buf;                // 写缓冲 (来自 buffer_pool，生成响应时申请)
+    int m_write_size;                 // 写缓冲容量
     int m_write_index;                // 当前写缓冲光标地址
-    char *m_file_addr;                // 客户请求的文件被mmap到内存中的地址
-    struct stat m_file_stat;          // 客户请求的文件的目标状态,通过它我们可以判断文件是否存在、是否为目录、是否可读，并获取文件大小等信息
-    struct iovec m_iv[2];             // 采用writev来进行写回操作。从多个内存块进行写数据
-    int m_iv_count;                   // 其中m_iv_count表示多个内存块的数量
+    file_entry *m_file;               // 客户请求的文件 (来自打开文件缓存，持有一个引用)。包含 fd、文件状态、映射地址
+    cached_response *m_cached;        // 命中的完整响应 (来自完整响应缓存，持有一个引用)
+
+    // 响应的一个片段：写缓冲中的一段内容 (首行+头部、错误页、多范围的分隔头部)，其后跟着文件的一个范围
+    struct segment
+    {
+        int head;     // 在写缓冲中的起始地址
+        int head_len; // 长度
+        off_t offset; // 文件范围 起始偏移
+        size_t size;  // 文件范围 长度，0 表示没有文件内容
+    };
+    // 一个待发送的响应：若干片段，或 缓存的完整响应
+    struct response
+    {
+        file_entry *file;        // 响应体文件 (持有一个引用)，没有为 NULL
+        cached_response *cached; // 缓存的完整响应 (持有一个引用)，没有为 NULL
+        bool linger;             // 缓存的完整响应 是否以 Connection: keep-alive 发送
+        int seg;                 // 第一个片段在 m_seg 中的下标
+        int seg_count;           // 片段数量
+    };
+    response m_resp[MAX_PIPELINE];      // 本批待发送的响应 (流水线请求 按顺序合并)
+    int m_resp_count;                   // 本批响应数量
+    segment m_seg[MAX_SEGMENTS];        // 本批响应的片段
+    int m_seg_count;                    // 本批片段数量
+    struct iovec m_iv[2 * (MAX_SEGMENTS + MAX_PIPELINE)]; // 采用writev来进行写回操作。一次写出本批所有响应
+    int m_iv_fd[2 * (MAX_SEGMENTS + MAX_PIPELINE)];       // 文件块的 fd：iov_base 为 NULL 的块由 sendfile 从该 fd 发送，
+                                                          // 已映射的块用于预读。头部、读入内存的文件 为 -1
+    off_t m_iv_offset[2 * (MAX_SEGMENTS + MAX_PIPELINE)]; // 文件块 下一次发送的文件偏移
+    bool m_iv_probe[2 * (MAX_SEGMENTS + MAX_PIPELINE)];   // 文件块 发送前是否检查页缓存 (热点文件不检查)
+    int m_iv_count;                     // 其中m_iv_count表示多个内存块的数量
+    int m_iv_index;                     // 第一个尚未发送完的内存块
+    bool m_keep_alive;                  // 本批最后一个响应是否保持连接
+    bool m_pending;                     // 本批达到合并上限，读缓冲中可能还有完整的请求
 
     int bytes_to_send;   // 待发送数据大小
     int bytes_have_send; // 已发送数据大小
@@ -192,8 +267,8 @@ class ulist_timer
 {
 public:
     // 节点类构造函数 （无参构造）
-    ulist_timer() : prev(nullptr), next(nullptr), expire(-1),
-                    func(nullptr), user_data(nullptr) {}
+    ulist_timer() : expire(-1), func(nullptr), user_data(nullptr),
+                    prev(nullptr), next(nullptr) {}
 
 public:
     time_t expire;             // 到期时间 : 绝对时间
@@ -203,36 +278,23 @@ public:
     ulist_timer *next;
 
 public:
-    time_t getExpireTime(time_t timeout)
+    // 单调时钟 当前时间 (毫秒)。不受系统时间调整影响
+    static time_t now_ms()
     {
-        struct timeval t;
-        gettimeofday(&t, NULL);
-        return (t.tv_sec * 1000) + (t.tv_usec / 1000) + 1000 * timeout;
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return (t.tv_sec * 1000) + (t.tv_nsec / 1000000);
     }
 
-    // 判断当前 时间节点 是否过期
-    bool isExpire()
+    // 判断当前 时间节点 是否过期。now 为调用者缓存的当前时间，避免每个节点都读一次时钟
+    bool isExpire(time_t now)
     {
-        struct timeval t;
-        gettimeofday(&t, NULL);
-        time_t curTime = (t.tv_sec * 1000) + (t.tv_usec / 1000);
-        // printf("curTime：%ld\n", curTime);
-        // printf("expire： %ld\n", expire);
-        // printf("curTime < expire : %d\n", curTime < expire);
-        if (curTime > this->expire)
-        {
-            // printf("=============过期\n");
-            return true;
-        }
-        else
-        {
-            // printf("---------------------不过期\n");
-            return false;
-        }
+        return now > this->expire;
     }
 };
 
 // 定时器链表  实现。 按到期时间 升序排列
+// 插入/更新 需要线性扫描，连接数量较多时开销为 O(n)。已由 timer_wheel 取代，保留用于 bench 对比
 class timer_list
 {
 public:
@@ -298,9 +360,9 @@ public:
         remove_node(timer); // 直接 摘除 timer
     }
 
-    // SIGALARM 信号每次被触发，就在其信号处理函数中 调用一次 tick() 函数。
+    // 定时信号每次被触发，就调用一次 tick() 函数。
     // 用以处理到期的链表任务
-    void tick()
+    void tick(time_t now)
     {
 
         printf("调用 -----------------trick()... \n");
@@ -317,9 +379,8 @@ public:
         while (cur != tail)
         {
             // printf("curTime: %ld\n", cur->expire);
-            // printf("当前节点：是否过期 %d\n", cur->isExpire());
             // 如果 当前节点过期
-            if (cur->isExpire())
+            if (cur->isExpire(now))
             {
                 ulist_timer *tmp = cur->next;
                 printf("trick()..... close fd : %d    ", cur->user_data->m_sockfd);
@@ -396,4 +457,138 @@ public:
     ulist_timer *tail;
 };
 
+#define TIMER_WHEEL_SLOTS 512 // 时间轮槽数 (2 的幂)
+#define TIMER_TICK_MS 100      // 每个槽对应的时间跨度 (毫秒)
+
+// 定时器时间轮 实现 (哈希时间轮)。
+// 定时器按到期时间 expire / TIMER_TICK_MS 散列到对应的槽中，每个槽是一个带哨兵的双向循环链表。
+// 添加、更新、删除 均为 O(1)；tick() 只扫描从上次 tick 到当前时间之间经过的槽。
+// 到期时间超过一圈的定时器，在被扫描到时若未到期则继续留在槽中，等待下一圈。
+// 时间轮缓存一次 单调时钟 读数 (update_now)，事件循环每轮只读一次时钟，设置定时器和 tick 都使用该缓存时间。
+class timer_wheel
+{
+public:
+    timer_wheel() : slots(new ulist_timer[TIMER_WHEEL_SLOTS])
+    {
+        // 每个槽的哨兵节点 自成环
+        for (int i = 0; i < TIMER_WHEEL_SLOTS; ++i)
+        {
+            slots[i].prev = slots + i;
+            slots[i].next = slots + i;
+        }
+        cur_now = ulist_timer::now_ms();
+        cur_tick = cur_now / TIMER_TICK_MS;
+    }
+
+    ~timer_wheel()
+    {
+        delete[] slots; // 定时器节点由 http_conn 自行释放
+    }
+
+    // 添加 定时器节点 到 对应的槽
+    void add_timer(ulist_timer *timer)
+    {
+        if (!timer)
+        {
+            return;
+        }
+        add_one(timer, slots + slot_of(timer->expire));
+    }
+
+    // 到期时间改变后，将定时器移动到新的槽
+    void update_timer(ulist_timer *timer)
+    {
+        if (!timer)
+        {
+            return;
+        }
+        remove_node(timer);
+        add_timer(timer);
+    }
+
+    void del_timer(ulist_timer *timer)
+    {
+        if (!timer || !timer->next)
+        {
+            return;
+        }
+        remove_node(timer); // 直接 摘除 timer
+    }
+
+    // 更新缓存的当前时间，事件循环每轮调用一次
+    time_t update_now()
+    {
+        cur_now = ulist_timer::now_ms();
+        return cur_now;
+    }
+
+    // 缓存的当前时间 (毫秒)
+    time_t now() const
+    {
+        return cur_now;
+    }
+
+    // 处理 上次 tick 到缓存的当前时间之间 经过的所有槽中的到期定时器
+    void tick()
+    {
+        time_t now_tick = cur_now / TIMER_TICK_MS;
+
+        // 经过的时间超过一圈，则所有槽都扫描一次即可
+        time_t steps = now_tick - cur_tick + 1;
+        if (steps > TIMER_WHEEL_SLOTS)
+        {
+            steps = TIMER_WHEEL_SLOTS;
+        }
+
+        for (time_t i = 0; i < steps; ++i)
+        {
+            ulist_timer *head = slots + slot_of((cur_tick + i) * TIMER_TICK_MS);
+            ulist_timer *cur = head->next;
+            while (cur != head)
+            {
+                ulist_timer *tmp = cur->next;
+                if (cur->isExpire(cur_now))
+                {
+                    cur->func(cur->user_data); // 回调中会调用 del_timer 摘除节点
+                }
+                cur = tmp;
+            }
+        }
+        cur_tick = now_tick;
+    }
+
+private:
+    // 到期时间 对应的槽下标
+    static int slot_of(time_t expire)
+    {
+        return (expire / TIMER_TICK_MS) & (TIMER_WHEEL_SLOTS - 1);
+    }
+
+    // 将 timer 加入到 哨兵 head 前面 (即槽链表尾部)
+    void add_one(ulist_timer *timer, ulist_timer *head)
+    {
+        timer->next = head;
+        timer->prev = head->prev;
+        head->prev->next = timer;
+        head->prev = timer;
+    }
+
+    // 将 timer 从所在槽中摘除
+    void remove_node(ulist_timer *timer)
+    {
+        if (timer->next)
+        {
+            timer->next->prev = timer->prev;
+            timer->prev->next = timer->next;
+            timer->next = nullptr;
+            timer->prev = nullptr;
+        }
+    }
+
+private:
+    ulist_timer *slots; // 槽数组 (哨兵节点)
+    time_t cur_tick;    // 上次 tick 处理到的时间刻度
+    time_t cur_now;     // 缓存的当前时间 (毫秒)
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*
+内容编码协商：
+
+    1. 支持的编码按服务器偏好排列 (压缩率高的在前)：br、zstd、gzip，预压缩文件的后缀分别为 .br、.zst、.gz
+    2. 解析 Accept-Encoding (含 q 值与 "*")，在 可用的编码 中选出客户端 q 值最高的，q 值相同时按服务器偏好
+*/
+
+#ifndef HTTP_ENCODING_H
+#define HTTP_ENCODING_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string_view>
+
+// 内容编码，顺序即服务器偏好
+enum CONTENT_ENCODING
+{
+    ENC_BR = 0,
+    ENC_ZSTD,
+    ENC_GZIP,
+    ENC_COUNT
+};
+
+static const char *const encoding_names[ENC_COUNT] = {"br", "zstd", "gzip"};   // Content-Encoding 的值
+static const char *const encoding_suffixes[ENC_COUNT] = {".br", ".zst", ".gz"}; // 预压缩文件的后缀
+
+// 解析 q 值 ("q=0.5")，没有 q 参数为 1
+inline int parse_qvalue(std::string_view params)
+{
+    size_t pos = params.find("q=");
+    if (pos == std::string_view::npos)
+    {
+        return 1000;
+    }
+    char buf[8] = {0};
+    std::string_view v = params.substr(pos + 2, sizeof(buf) - 1);
+    v.copy(buf, v.size());
+    return (int)(atof(buf) * 1000); // 按千分之一比较
+}
+
+// 在 available (按 CONTENT_ENCODING 的位掩码) 中选出客户端接受的最佳编码，没有返回 -1
+inline int choose_encoding(std::string_view accept, unsigned available)
+{
+    int q[ENC_COUNT];
+    int star = -1; // "*" 的 q 值，-1 表示未出现
+    for (int i = 0; i < ENC_COUNT; ++i)
+    {
+        q[i] = -1; // 未出现
+    }
+
+    size_t pos = 0;
+    while (pos < accept.size())
+    {
+        size_t end = accept.find(',', pos);
+        if (end == std::string_view::npos)
+        {
+            end = accept.size();
+        }
+        std::string_view item = accept.substr(pos, end - pos);
+        pos = end + 1;
+
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t'))
+        {
+            item.remove_prefix(1);
+        }
+        size_t semi = item.find(';');
+        std::string_view name = item.substr(0, semi);
+        while (!name.empty() && (name.back() == ' ' || name.back() == '\t'))
+        {
+            name.remove_suffix(1);
+        }
+        int value = semi == std::string_view::npos ? 1000 : parse_qvalue(item.substr(semi + 1));
+        if (name == "*")
+        {
+            star = value;
+            continue;
+        }
+        for (int i = 0; i < ENC_COUNT; ++i)
+        {
+            if (name.size() == strlen(encoding_names[i]) && strncasecmp(name.data(), encoding_names[i], name.size()) == 0)
+            {
+                q[i] = value;
+            }
+        }
+    }
+
+    int best = -1;
+    int best_q = 0;
+    for (int i = 0; i < ENC_COUNT; ++i)
+    {
+        int value = q[i] >= 0 ? q[i] : star; // 未单独列出的编码 使用 "*" 的 q 值
+        if ((available & (1u << i)) && value > best_q)
+        {
+            best = i;
+            best_q = value;
+        }
+    }
+    return best;
+}
+
+#endif
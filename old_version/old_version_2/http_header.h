@@ -0,0 +1,237 @@
+/*
+HTTP 请求头部索引：
+
+    解析时把每个头部记录为指向读缓冲区的 string_view (不拷贝)，存放在定长的 header_table 中。
+    已知的头部名称通过 编译期生成的完美哈希 映射为 HEADER_ID，之后的功能按 id O(1) 取值，无需重新扫描缓冲区。
+    注意：string_view 指向 http_conn 的读缓冲区，读缓冲区被移动/复用后需要重新定位或清空。
+*/
+
+#ifndef HTTP_HEADER_H
+#define HTTP_HEADER_H
+
+#include <stddef.h>
+#include <strings.h>
+#include <string_view>
+
+// 已知的请求头部
+enum HEADER_ID
+{
+    HDR_UNKNOWN = 0,
+    HDR_HOST,
+    HDR_CONNECTION,
+    HDR_CONTENT_LENGTH,
+    HDR_ACCEPT,
+    HDR_ACCEPT_ENCODING,
+    HDR_ACCEPT_LANGUAGE,
+    HDR_USER_AGENT,
+    HDR_REFERER,
+    HDR_COOKIE,
+    HDR_AUTHORIZATION,
+    HDR_CACHE_CONTROL,
+    HDR_PRAGMA,
+    HDR_RANGE,
+    HDR_IF_RANGE,
+    HDR_IF_MATCH,
+    HDR_IF_NONE_MATCH,
+    HDR_IF_MODIFIED_SINCE,
+    HDR_IF_UNMODIFIED_SINCE,
+    HDR_ID_SIZE
+};
+
+// 已知头部的名称，下标为 HEADER_ID
+constexpr std::string_view header_names[HDR_ID_SIZE] = {
+    "",
+    "Host",
+    "Connection",
+    "Content-Length",
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Language",
+    "User-Agent",
+    "Referer",
+    "Cookie",
+    "Authorization",
+    "Cache-Control",
+    "Pragma",
+    "Range",
+    "If-Range",
+    "If-Match",
+    "If-None-Match",
+    "If-Modified-Since",
+    "If-Unmodified-Since",
+};
+
+#define HEADER_HASH_SIZE 64 // 完美哈希表大小 (2 的幂)
+
+// 头部名称哈希：只取 长度、首字符、中间字符、末字符 (忽略大小写)，不遍历整个名称
+constexpr unsigned header_hash(const char *name, size_t len, unsigned seed)
+{
+    unsigned h = (unsigned)len * seed;
+    h = (h ^ (unsigned char)(name[0] | 0x20)) * seed;
+    h = (h ^ (unsigned char)(name[len / 2] | 0x20)) * seed;
+    h = (h ^ (unsigned char)(name[len - 1] | 0x20)) * seed;
+    return (h >> 16) & (HEADER_HASH_SIZE - 1);
+}
+
+// 编译期搜索 使所有已知头部都不冲突的 哈希种子
+constexpr unsigned header_find_seed()
+{
+    for (unsigned seed = 0x9E3779B1u; seed < 0x9E3779B1u + 200000u; seed += 2)
+    {
+        bool used[HEADER_HASH_SIZE] = {};
+        bool ok = true;
+        for (int id = 1; id < HDR_ID_SIZE && ok; ++id)
+        {
+            unsigned h = header_hash(header_names[id].data(), header_names[id].size(), seed);
+            ok = !used[h];
+            used[h] = true;
+        }
+        if (ok)
+        {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+constexpr unsigned HEADER_SEED = header_find_seed();
+static_assert(HEADER_SEED != 0, "no perfect hash seed for known headers");
+
+// 编译期生成的 哈希槽 -> HEADER_ID 映射表
+struct header_hash_table
+{
+    unsigned char ids[HEADER_HASH_SIZE];
+
+    constexpr header_hash_table() : ids()
+    {
+        for (int id = 1; id < HDR_ID_SIZE; ++id)
+        {
+            ids[header_hash(header_names[id].data(), header_names[id].size(), HEADER_SEED)] = id;
+        }
+    }
+};
+
+constexpr header_hash_table header_lookup_table;
+
+// 头部名称 -> HEADER_ID。哈希定位后只需 一次 忽略大小写的比较确认
+inline HEADER_ID header_id(const char *name, size_t len)
+{
+    if (len == 0)
+    {
+        return HDR_UNKNOWN;
+    }
+    int id = header_lookup_table.ids[header_hash(name, len, HEADER_SEED)];
+    if (id != HDR_UNKNOWN && header_names[id].size() == len && strncasecmp(name, header_names[id].data(), len) == 0)
+    {
+        return (HEADER_ID)id;
+    }
+    return HDR_UNKNOWN;
+}
+
+// 一个请求头部
+struct http_header
+{
+    HEADER_ID id;           // 已知头部的 id，未知为 HDR_UNKNOWN
+    std::string_view name;  // 头部名称 (指向读缓冲区)
+    std::string_view value; // 头部值 (指向读缓冲区，已去除首尾空白)
+};
+
+// 定长请求头部表
+// 记录满 MAX_HEADERS 个后 不再记录未知头部与重复的已知头部，但每个已知头部的第一次出现 仍然记录 (预留 HDR_ID_SIZE 个位置)，
+// 头部很多的请求不会被拒绝，也不会丢失后续功能要查询的头部
+class header_table
+{
+public:
+    static const int MAX_HEADERS = 48; // 每个请求 按出现顺序 最多记录的头部数量
+
+    header_table() { clear(); }
+
+    // 清空头部表
+    void clear()
+    {
+        m_size = 0;
+        for (int i = 0; i < HDR_ID_SIZE; ++i)
+        {
+            m_index[i] = 0;
+        }
+    }
+
+    // 由一行的 名称与值 生成头部：查找已知头部 id，去除 值 末尾的空白
+    static http_header make(const char *name, size_t name_len, const char *value, size_t value_len)
+    {
+        while (value_len > 0 && (value[value_len - 1] == ' ' || value[value_len - 1] == '\t'))
+        {
+            --value_len;
+        }
+        http_header h;
+        h.id = header_id(name, name_len);
+        h.name = std::string_view(name, name_len);
+        h.value = std::string_view(value, value_len);
+        return h;
+    }
+
+    // 记录一个头部，表已满而跳过时返回假。重复的已知头部 以第一个为准
+    bool add(const http_header &h)
+    {
+        bool first = h.id != HDR_UNKNOWN && m_index[h.id] == 0;
+        if (m_size >= MAX_HEADERS && !first)
+        {
+            return false;
+        }
+        m_headers[m_size++] = h;
+        if (first)
+        {
+            m_index[h.id] = m_size; // 下标 + 1，0 表示不存在
+        }
+        return true;
+    }
+
+    // 按 id 取头部，不存在返回 NULL
+    const http_header *find(HEADER_ID id) const
+    {
+        return m_index[id] ? m_headers + m_index[id] - 1 : NULL;
+    }
+
+    // 按 id 取头部值，不存在返回空
+    std::string_view get(HEADER_ID id) const
+    {
+        const http_header *h = find(id);
+        return h ? h->value : std::string_view();
+    }
+
+    // 是否存在该头部
+    bool has(HEADER_ID id) const
+    {
+        return m_index[id] != 0;
+    }
+
+    // 读缓冲区从 old_base 移动到 new_base 后，重新定位所有 string_view
+    void rebase(const char *old_base, const char *new_base)
+    {
+        for (int i = 0; i < m_size; ++i)
+        {
+            http_header &h = m_headers[i];
+            h.name = std::string_view(new_base + (h.name.data() - old_base), h.name.size());
+            h.value = std::string_view(new_base + (h.value.data() - old_base), h.value.size());
+        }
+    }
+
+    // 头部数量
+    int size() const
+    {
+        return m_size;
+    }
+
+    // 第 i 个头部
+    const http_header &at(int i) const
+    {
+        return m_headers[i];
+    }
+
+private:
+    http_header m_headers[MAX_HEADERS + HDR_ID_SIZE]; // 按出现顺序记录的头部
+    int m_size;                                       // 已记录的头部数量
+    unsigned char m_index[HDR_ID_SIZE];               // 已知头部 -> 下标 + 1
+};
+
+#endif
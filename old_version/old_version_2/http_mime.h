@@ -0,0 +1,78 @@
+/*
+扩展名 -> MIME 类型：
+
+    按文件扩展名 (不区分大小写) 查表得到 Content-Type，未知扩展名为 application/octet-stream。
+    表中同时标记该类型是否值得压缩 (文本类)，只有这些类型才查找预压缩文件。
+*/
+
+#ifndef HTTP_MIME_H
+#define HTTP_MIME_H
+
+#include <string.h>
+#include <strings.h>
+
+struct mime_entry
+{
+    const char *ext;   // 扩展名 (不含 '.')
+    const char *type;  // MIME 类型
+    bool compressible; // 是否为可压缩的文本类型
+};
+
+static const mime_entry mime_table[] = {
+    {"html", "text/html", true},
+    {"htm", "text/html", true},
+    {"css", "text/css", true},
+    {"js", "application/javascript", true},
+    {"mjs", "application/javascript", true},
+    {"json", "application/json", true},
+    {"map", "application/json", true},
+    {"xml", "application/xml", true},
+    {"txt", "text/plain", true},
+    {"md", "text/markdown", true},
+    {"csv", "text/csv", true},
+    {"svg", "image/svg+xml", true},
+    {"wasm", "application/wasm", true},
+    {"ico", "image/x-icon", true},
+    {"ttf", "font/ttf", true},
+    {"otf", "font/otf", true},
+    {"woff", "font/woff", false},
+    {"woff2", "font/woff2", false},
+    {"png", "image/png", false},
+    {"jpg", "image/jpeg", false},
+    {"jpeg", "image/jpeg", false},
+    {"gif", "image/gif", false},
+    {"webp", "image/webp", false},
+    {"avif", "image/avif", false},
+    {"bmp", "image/bmp", false},
+    {"mp4", "video/mp4", false},
+    {"webm", "video/webm", false},
+    {"ogg", "audio/ogg", false},
+    {"mp3", "audio/mpeg", false},
+    {"wav", "audio/wav", false},
+    {"pdf", "application/pdf", false},
+    {"zip", "application/zip", false},
+    {"gz", "application/gzip", false},
+};
+
+static const mime_entry mime_default = {"", "application/octet-stream", false};
+
+// 按路径的扩展名查找 MIME 类型
+inline const mime_entry *mime_lookup(const char *path)
+{
+    const char *dot = strrchr(path, '.');
+    const char *slash = strrchr(path, '/');
+    if (dot == NULL || (slash != NULL && dot < slash))
+    {
+        return &mime_default; // 没有扩展名
+    }
+    for (const mime_entry &m : mime_table)
+    {
+        if (strcasecmp(dot + 1, m.ext) == 0)
+        {
+            return &m;
+        }
+    }
+    return &mime_default;
+}
+
+#endif
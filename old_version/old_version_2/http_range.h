@@ -0,0 +1,136 @@
+/*
+范围请求 (RFC 7233)：
+
+    1. 解析 Range: bytes=first-last, first-, -suffix，结果截断到文件大小以内
+    2. 单位不是 bytes、语法错误、范围过多 时忽略 Range 头部 (按普通请求返回整个文件)
+    3. 所有范围都不可满足时 返回 416
+*/
+
+#ifndef HTTP_RANGE_H
+#define HTTP_RANGE_H
+
+#include <strings.h>
+#include <sys/types.h>
+#include <string_view>
+
+#define MAX_RANGES 8 // 每个请求最多的范围数量，超出则忽略 Range
+
+// 一个字节范围 [first, last]
+struct byte_range
+{
+    off_t first;
+    off_t last;
+};
+
+// Range 头部的解析结果
+enum RANGE_RESULT
+{
+    RANGE_NONE = 0,       // 没有可用的 Range 头部 (发送整个文件)
+    RANGE_OK,             // 至少有一个可满足的范围
+    RANGE_UNSATISFIABLE   // 所有范围都不可满足 (416)
+};
+
+// 解析非负整数。没有数字或溢出返回假
+inline bool parse_range_number(std::string_view s, size_t *pos, off_t *value)
+{
+    size_t start = *pos;
+    off_t v = 0;
+    while (*pos < s.size() && s[*pos] >= '0' && s[*pos] <= '9')
+    {
+        if (v > ((off_t)1 << 62) / 10)
+        {
+            return false;
+        }
+        v = v * 10 + (s[*pos] - '0');
+        ++*pos;
+    }
+    *value = v;
+    return *pos > start;
+}
+
+// 解析 Range 头部值。可满足的范围 按出现顺序 写入 ranges，数量写入 count
+inline RANGE_RESULT parse_range(std::string_view value, off_t size, byte_range *ranges, int *count)
+{
+    *count = 0;
+    if (value.size() < 6 || strncasecmp(value.data(), "bytes=", 6) != 0)
+    {
+        return RANGE_NONE; // 不支持的单位
+    }
+    size_t pos = 6;
+    int specs = 0;
+    while (true)
+    {
+        while (pos < value.size() && (value[pos] == ' ' || value[pos] == '\t'))
+        {
+            ++pos;
+        }
+        off_t first = -1, last = -1;
+        if (pos < value.size() && value[pos] == '-')
+        {
+            // -suffix：最后 suffix 个字节
+            ++pos;
+            off_t suffix;
+            if (!parse_range_number(value, &pos, &suffix))
+            {
+                return RANGE_NONE;
+            }
+            if (suffix > 0 && size > 0)
+            {
+                first = suffix < size ? size - suffix : 0;
+                last = size - 1;
+            }
+        }
+        else
+        {
+            // first-last 或 first-
+            if (!parse_range_number(value, &pos, &first) || pos >= value.size() || value[pos] != '-')
+            {
+                return RANGE_NONE;
+            }
+            ++pos;
+            if (!parse_range_number(value, &pos, &last))
+            {
+                last = size - 1;
+            }
+            else if (last < first)
+            {
+                return RANGE_NONE; // 语法错误
+            }
+            if (first >= size)
+            {
+                first = -1; // 不可满足
+            }
+            else if (last >= size)
+            {
+                last = size - 1;
+            }
+        }
+        if (++specs > MAX_RANGES)
+        {
+            return RANGE_NONE; // 范围过多，忽略
+        }
+        if (first >= 0)
+        {
+            ranges[*count].first = first;
+            ranges[*count].last = last;
+            ++*count;
+        }
+
+        while (pos < value.size() && (value[pos] == ' ' || value[pos] == '\t'))
+        {
+            ++pos;
+        }
+        if (pos == value.size())
+        {
+            break;
+        }
+        if (value[pos] != ',')
+        {
+            return RANGE_NONE;
+        }
+        ++pos;
+    }
+    return *count > 0 ? RANGE_OK : RANGE_UNSATISFIABLE;
+}
+
+#endif
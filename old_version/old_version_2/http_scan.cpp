@@ -0,0 +1,369 @@
+#include "http_scan.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_SCAN_X86
+#endif
+
+typedef const char *(*find2_func)(const char *, const char *, char, char);
+
+// 一块 64 字节的分类位图，第 i 位对应块中第 i 个字节
+struct scan_block
+{
+    uint64_t eol;   // \r 或 \n
+    uint64_t space; // 空格或 \t
+    uint64_t colon; // ':'
+};
+
+typedef void (*classify_func)(const char *, scan_block *);
+
+// 标量实现：逐字节分类
+static void classify_scalar(const char *p, scan_block *b)
+{
+    uint64_t eol = 0, space = 0, colon = 0;
+    for (int i = 0; i < 64; ++i)
+    {
+        uint64_t bit = 1ULL << i;
+        switch (p[i])
+        {
+        case '\r':
+        case '\n':
+            eol |= bit;
+            break;
+        case ' ':
+        case '\t':
+            space |= bit;
+            break;
+        case ':':
+            colon |= bit;
+            break;
+        default:
+            break;
+        }
+    }
+    b->eol = eol;
+    b->space = space;
+    b->colon = colon;
+}
+
+// 标量实现
+static const char *find2_scalar(const char *begin, const char *end, char a, char b)
+{
+    for (; begin < end; ++begin)
+    {
+        if (*begin == a || *begin == b)
+        {
+            break;
+        }
+    }
+    return begin;
+}
+
+#ifdef HTTP_SCAN_X86
+// SSE2 实现：每次比较 16 个字节
+__attribute__((target("sse2"))) static const char *find2_sse2(const char *begin, const char *end, char a, char b)
+{
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    while (end - begin >= 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)begin);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)));
+        if (mask)
+        {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 16;
+    }
+    return find2_scalar(begin, end, a, b);
+}
+
+// AVX2 实现：每次比较 32 个字节，剩余不足 32 字节 在本函数内按 16 字节处理
+// (不调用 find2_sse2，避免 AVX 与 非VEX 编码的 SSE 指令混用带来的状态切换开销)
+__attribute__((target("avx2"))) static const char *find2_avx2(const char *begin, const char *end, char a, char b)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    while (end - begin >= 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)begin);
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)));
+        if (mask)
+        {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 32;
+    }
+    if (end - begin >= 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)begin);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm256_castsi256_si128(va)),
+                                                  _mm_cmpeq_epi8(x, _mm256_castsi256_si128(vb))));
+        if (mask)
+        {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 16;
+    }
+    for (; begin < end; ++begin)
+    {
+        if (*begin == a || *begin == b)
+        {
+            break;
+        }
+    }
+    return begin;
+}
+
+// SSE2 实现：每次分类 16 个字节
+__attribute__((target("sse2"))) static void classify_sse2(const char *p, scan_block *b)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i co = _mm_set1_epi8(':');
+    uint64_t eol = 0, space = 0, colon = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+        eol |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, cr), _mm_cmpeq_epi8(x, lf))) << (16 * i);
+        space |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, sp), _mm_cmpeq_epi8(x, tab))) << (16 * i);
+        colon |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, co)) << (16 * i);
+    }
+    b->eol = eol;
+    b->space = space;
+    b->colon = colon;
+}
+
+// AVX2 实现：每次分类 32 个字节
+__attribute__((target("avx2"))) static void classify_avx2(const char *p, scan_block *b)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i sp = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i co = _mm256_set1_epi8(':');
+    uint64_t eol = 0, space = 0, colon = 0;
+    for (int i = 0; i < 2; ++i)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + 32 * i));
+        eol |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, cr), _mm256_cmpeq_epi8(x, lf)))
+               << (32 * i);
+        space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, sp), _mm256_cmpeq_epi8(x, tab)))
+                 << (32 * i);
+        colon |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, co)) << (32 * i);
+    }
+    b->eol = eol;
+    b->space = space;
+    b->colon = colon;
+}
+#endif
+
+// 根据 CPU 支持的指令集 选择实现
+static SCAN_IMPL detect_impl()
+{
+#ifdef HTTP_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return SCAN_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return SCAN_SSE2;
+    }
+#endif
+    return SCAN_SCALAR;
+}
+
+static find2_func impl_func(SCAN_IMPL impl)
+{
+#ifdef HTTP_SCAN_X86
+    switch (impl)
+    {
+    case SCAN_AVX2:
+        return find2_avx2;
+    case SCAN_SSE2:
+        return find2_sse2;
+    default:
+        break;
+    }
+#endif
+    return find2_scalar;
+}
+
+static classify_func impl_classify(SCAN_IMPL impl)
+{
+#ifdef HTTP_SCAN_X86
+    switch (impl)
+    {
+    case SCAN_AVX2:
+        return classify_avx2;
+    case SCAN_SSE2:
+        return classify_sse2;
+    default:
+        break;
+    }
+#endif
+    return classify_scalar;
+}
+
+static SCAN_IMPL s_impl = detect_impl();                  // 当前使用的扫描实现
+static find2_func s_find2 = impl_func(s_impl);            // 当前使用的扫描函数
+static classify_func s_classify = impl_classify(s_impl); // 当前使用的分类函数
+
+// 开始扫描一个新请求
+void http_scan_reset(http_scan_state *state)
+{
+    state->pos = 0;
+    state->line = 0;
+    state->lines = 0;
+    state->delim1 = -1;
+    state->delim2 = -1;
+}
+
+// 一次扫描请求头部。每块 64 字节分类一次，再按位图从低到高 依次处理本行关心的字符：
+// 请求行关心 空格/\t (前两个)，头部行关心 ':' (第一个)，所有行关心 行结束符。\r 必须紧跟 \n
+SCAN_STATUS http_scan_request(const char *buf, int len, http_scan_state *state, http_line *lines, int max, int *count)
+{
+    int n = 0;
+    char tail[64];
+    *count = 0;
+    while (state->pos < len)
+    {
+        int base = state->pos;
+        const char *p = buf + base;
+        if (len - base < 64)
+        {
+            // 不足一块：拷贝到补零的临时块，0 不属于任何一类
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, p, len - base);
+            p = tail;
+        }
+        scan_block b;
+        s_classify(p, &b);
+        uint64_t eol = b.eol, space = b.space, colon = b.colon;
+        while (true)
+        {
+            uint64_t want = eol;
+            if (state->lines == 0)
+            {
+                want |= state->delim2 < 0 ? space : 0;
+            }
+            else
+            {
+                want |= state->delim1 < 0 ? colon : 0;
+            }
+            if (want == 0)
+            {
+                break;
+            }
+            int i = __builtin_ctzll(want);
+            uint64_t seen = (want & -want) | ((want & -want) - 1); // 第 i 位及以下
+            eol &= ~seen;
+            space &= ~seen;
+            colon &= ~seen;
+            int at = base + i;
+            if (!((b.eol >> i) & 1))
+            {
+                // 分隔符：请求行的空格/\t 或 头部行的 ':'
+                if (state->delim1 < 0)
+                {
+                    state->delim1 = at;
+                }
+                else
+                {
+                    state->delim2 = at;
+                }
+                continue;
+            }
+            if (buf[at] == '\r')
+            {
+                if (at + 1 >= len)
+                {
+                    state->pos = at; // \r 是最后一个字节，读入更多数据后 从 \r 处继续
+                    *count = n;
+                    return SCAN_PARTIAL;
+                }
+                if (buf[at + 1] != '\n')
+                {
+                    return SCAN_BAD;
+                }
+                continue; // 行在 \n 处结束
+            }
+            // \n：前一个字节必须是本行的 \r
+            if (at == state->line || buf[at - 1] != '\r')
+            {
+                return SCAN_BAD;
+            }
+            http_line &l = lines[n++];
+            l.begin = state->line;
+            l.end = at - 1;
+            l.delim1 = state->delim1;
+            l.delim2 = state->delim2;
+            bool blank = state->lines > 0 && l.end == l.begin;
+            ++state->lines;
+            state->line = at + 1;
+            state->delim1 = -1;
+            state->delim2 = -1;
+            state->pos = at + 1;
+            if (blank || n == max)
+            {
+                *count = n;
+                return blank ? SCAN_DONE : SCAN_MORE;
+            }
+        }
+        state->pos = len - base < 64 ? len : base + 64;
+    }
+    *count = n;
+    return SCAN_PARTIAL;
+}
+
+// 在 [begin, end) 中查找第一个等于 a 或 b 的字符
+const char *http_find2(const char *begin, const char *end, char a, char b)
+{
+    return s_find2(begin, end, a, b);
+}
+
+// 在 [begin, end) 中查找第一个等于 c 的字符
+const char *http_find1(const char *begin, const char *end, char c)
+{
+    return s_find2(begin, end, c, c);
+}
+
+// 当前使用的扫描实现
+SCAN_IMPL http_scan_impl()
+{
+    return s_impl;
+}
+
+// 指定扫描实现 (CPU 不支持时返回假)
+bool http_scan_set_impl(SCAN_IMPL impl)
+{
+    if (impl > detect_impl())
+    {
+        return false;
+    }
+    s_impl = impl;
+    s_find2 = impl_func(impl);
+    s_classify = impl_classify(impl);
+    return true;
+}
+
+// 扫描实现的名称
+const char *http_scan_name(SCAN_IMPL impl)
+{
+    switch (impl)
+    {
+    case SCAN_AVX2:
+        return "avx2";
+    case SCAN_SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,73 @@
+/*
+HTTP 报文扫描函数：
+
+    用 SIMD 指令一次比较 16 (SSE2) / 32 (AVX2) 个字节，查找 行结束符、分隔符 的位置，
+    代替逐字节扫描。程序启动时根据 CPU 支持的指令集选择实现，不支持时使用标量实现。
+
+    请求头部 一次扫描 (http_scan_request)：每 64 字节一块，一次比较得到 行结束符、空格/\t、':' 三个位图，
+    按位图依次取出 请求行的两个分隔符、每个头部行的第一个 ':' 与行尾，得到所有字段的偏移；一次调用内 每个字节只比较一次。
+    扫描状态跨多次读入保存，数据不完整时 下次从上次停下的位置继续
+*/
+
+#ifndef HTTP_SCAN_H
+#define HTTP_SCAN_H
+
+// 扫描实现
+enum SCAN_IMPL
+{
+    SCAN_SCALAR = 0, // 逐字节
+    SCAN_SSE2,       // 16 字节
+    SCAN_AVX2        // 32 字节
+};
+
+// 请求头部扫描结果
+enum SCAN_STATUS
+{
+    SCAN_PARTIAL = 0, // 数据不完整，读入更多数据后 从上次停下的位置继续扫描
+    SCAN_MORE,        // 行表已满，处理完这些行后 继续扫描
+    SCAN_DONE,        // 遇到头部结束的空行 (空行也在行表中)
+    SCAN_BAD          // 行结束符不合法 (单独的 \r 或 \n)
+};
+
+// 一行的字段偏移 (相对于请求起始)
+struct http_line
+{
+    int begin;  // 行首
+    int end;    // 行尾，即 \r 的位置
+    int delim1; // 请求行：第一个空格或 \t；头部行：第一个 ':'。没有为 -1
+    int delim2; // 请求行：第二个空格或 \t。没有为 -1
+};
+
+// 跨多次读入保存的扫描状态
+struct http_scan_state
+{
+    int pos;    // 下一个要扫描的偏移
+    int line;   // 当前行 行首
+    int lines;  // 已扫描完的行数，第 0 行为请求行
+    int delim1; // 当前行 已找到的分隔符
+    int delim2;
+};
+
+// 开始扫描一个新请求
+void http_scan_reset(http_scan_state *state);
+
+// 从 state->pos 继续扫描请求 [buf, buf + len)，把扫描完的行 (最多 max 行) 写入 lines，行数写入 count。
+// 只读取 buf，调用者可以改写 已返回的行
+SCAN_STATUS http_scan_request(const char *buf, int len, http_scan_state *state, http_line *lines, int max, int *count);
+
+// 在 [begin, end) 中查找第一个等于 a 或 b 的字符，返回其地址，找不到返回 end
+const char *http_find2(const char *begin, const char *end, char a, char b);
+
+// 在 [begin, end) 中查找第一个等于 c 的字符，返回其地址，找不到返回 end
+const char *http_find1(const char *begin, const char *end, char c);
+
+// 当前使用的扫描实现
+SCAN_IMPL http_scan_impl();
+
+// 指定扫描实现 (CPU 不支持时返回假)，用于基准测试
+bool http_scan_set_impl(SCAN_IMPL impl);
+
+// 扫描实现的名称
+const char *http_scan_name(SCAN_IMPL impl);
+
+#endif
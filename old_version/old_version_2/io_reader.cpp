@@ -0,0 +1,237 @@
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "io_reader.h"
+#include "http_conn.h"
+#include "log.h"
+
+extern void modifyfd(int epfd, int fd, int ev);
+
+static std::atomic<bool> s_nowait(true); // 内核是否支持 RWF_NOWAIT
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+io_reader::io_reader() : m_stop(false), m_thread_count(0), m_submitted(0), m_bytes(0), m_wait_ns(0),
+                         m_max_ns(0), m_reported(0)
+{
+}
+
+io_reader::~io_reader()
+{
+    stop();
+}
+
+// 线程入口函数
+void *io_reader::worker(void *arg)
+{
+    io_reader *reader = (io_reader *)arg;
+    reader->run();
+    return reader;
+}
+
+// 启动 I/O 线程。一个都无法启动时返回假
+bool io_reader::start()
+{
+    for (int i = 0; i < IO_READER_THREADS; ++i)
+    {
+        if (pthread_create(m_threads + m_thread_count, NULL, worker, this) == 0)
+        {
+            ++m_thread_count;
+        }
+    }
+    return m_thread_count > 0;
+}
+
+// 通知 I/O 线程退出，并等待其结束。未处理的请求 关闭 fd 后丢弃 (此时事件循环已停止)
+void io_reader::stop()
+{
+    m_lock.lock();
+    m_stop = true;
+    m_lock.unlock();
+    for (int i = 0; i < m_thread_count; ++i)
+    {
+        m_sem.post();
+    }
+    for (int i = 0; i < m_thread_count; ++i)
+    {
+        pthread_join(m_threads[i], NULL);
+    }
+    m_thread_count = 0;
+    for (const job &j : m_jobs)
+    {
+        close(j.fd);
+    }
+    m_jobs.clear();
+}
+
+// 在区间的 第一页与最后一页 各读 1 字节，RWF_NOWAIT 使不在页缓存中的读取直接返回 EAGAIN。
+// 每个发送窗口最多 2 次系统调用：页缓存按顺序预读与回收，首尾都在时 中间通常也在，少数缺页由 sendfile 承担
+bool io_reader::resident(int fd, off_t offset, size_t len)
+{
+    static const long page = sysconf(_SC_PAGESIZE);
+    if (len == 0 || !s_nowait.load(std::memory_order_relaxed))
+    {
+        return true;
+    }
+    char byte;
+    struct iovec iv = {&byte, 1};
+    off_t end = offset + len - 1;
+    for (off_t pos = offset;; pos = end)
+    {
+        if (preadv2(fd, &iv, 1, pos, RWF_NOWAIT) < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                return false;
+            }
+            if (errno == EOPNOTSUPP || errno == ENOSYS || errno == EINVAL)
+            {
+                s_nowait.store(false, std::memory_order_relaxed); // 内核不支持，之后不再检查
+            }
+            return true; // 其他错误交给 sendfile 处理
+        }
+        if (pos == end || pos / page == end / page)
+        {
+            return true;
+        }
+    }
+}
+
+// mincore 检查映射区间的每一页
+bool io_reader::resident(const char *addr, size_t len)
+{
+    static const long page = sysconf(_SC_PAGESIZE);
+    unsigned char vec[IO_WINDOW / 4096 + 2];
+    uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(page - 1);
+    uintptr_t end = (uintptr_t)addr + (len < IO_WINDOW ? len : IO_WINDOW);
+    size_t pages = (end - start + page - 1) / page;
+    if (len == 0 || pages > sizeof(vec) || mincore((void *)start, end - start, vec) != 0)
+    {
+        return true;
+    }
+    for (size_t i = 0; i < pages; ++i)
+    {
+        if (!(vec[i] & 1))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 提交预读请求
+bool io_reader::submit(http_conn *conn, int fd, off_t offset, size_t len)
+{
+    if (m_thread_count == 0)
+    {
+        return false;
+    }
+    job j;
+    j.conn = conn;
+    j.epfd = conn->m_epfd;
+    j.sockfd = conn->m_sockfd;
+    j.seq = conn->m_io_seq.load();
+    j.offset = offset;
+    j.len = len < IO_WINDOW ? len : IO_WINDOW;
+    j.queued = now_ns();
+
+    m_lock.lock();
+    if (m_stop || m_jobs.size() >= IO_QUEUE_MAX || (j.fd = dup(fd)) == -1)
+    {
+        m_lock.unlock();
+        return false;
+    }
+    m_jobs.push_back(j);
+    m_lock.unlock();
+    m_sem.post();
+    m_submitted.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// 连接关闭前取消等待。与 I/O 线程的 "清除标记 + 重新注册" 在同一把锁内，返回后 I/O 线程不会再访问该连接的 fd
+void io_reader::cancel(http_conn *conn)
+{
+    m_lock.lock();
+    conn->m_io_wait.store(false);
+    m_lock.unlock();
+}
+
+// I/O 线程：取出请求，读入区间 (数据进入页缓存)，为仍在等待的连接重新注册 EPOLLOUT
+void io_reader::run()
+{
+    char *buf = new char[IO_WINDOW];
+    while (true)
+    {
+        m_sem.wait();
+        m_lock.lock();
+        if (m_stop)
+        {
+            m_lock.unlock();
+            break;
+        }
+        if (m_jobs.empty())
+        {
+            m_lock.unlock();
+            continue;
+        }
+        job j = m_jobs.front();
+        m_jobs.pop_front();
+        m_lock.unlock();
+
+        // 阻塞读取。文件被截断时读到末尾为止，由 sendfile 发现截断
+        size_t done = 0;
+        while (done < j.len)
+        {
+            ssize_t n = pread(j.fd, buf, j.len - done, j.offset + done);
+            if (n <= 0)
+            {
+                break;
+            }
+            done += n;
+        }
+        close(j.fd);
+        m_bytes.fetch_add(done, std::memory_order_relaxed);
+
+        // 先清除标记 再重新注册：注册之后事件循环可能立即继续发送、并为下一个窗口再次等待。
+        // 序号不同 说明连接已关闭、连接对象被复用同一 fd 的新连接重新等待，不能替新连接清除标记
+        m_lock.lock();
+        if (j.conn->m_io_seq.load() == j.seq && j.conn->m_io_wait.exchange(false))
+        {
+            modifyfd(j.epfd, j.sockfd, EPOLLOUT);
+        }
+        m_lock.unlock();
+
+        long long cost = now_ns() - j.queued;
+        m_wait_ns.fetch_add(cost, std::memory_order_relaxed);
+        long long max = m_max_ns.load(std::memory_order_relaxed);
+        while (cost > max && !m_max_ns.compare_exchange_weak(max, cost, std::memory_order_relaxed))
+        {
+        }
+    }
+    delete[] buf;
+}
+
+// 统计有变化时 写入日志
+void io_reader::report()
+{
+    long long submitted = m_submitted.load(std::memory_order_relaxed);
+    if (submitted == m_reported)
+    {
+        return;
+    }
+    long long waits = submitted - m_reported;
+    m_reported = submitted;
+    LOG_INFO("io reader: cold reads=%lld (+%lld), bytes=%lld, avg wait=%.2f ms, max wait=%.2f ms.", submitted, waits,
+             m_bytes.load(std::memory_order_relaxed), m_wait_ns.exchange(0, std::memory_order_relaxed) / 1e6 / waits,
+             m_max_ns.exchange(0, std::memory_order_relaxed) / 1e6);
+}
@@ -0,0 +1,95 @@
+/*
+冷文件预读类：
+
+    采用 单例模式 (懒汉模式)，所有事件循环共享
+    1. 事件循环线程在 sendfile / writev 文件内容之前，先不阻塞地检查 即将发送的区间 是否在页缓存中：
+       sendfile 的文件用 preadv2(RWF_NOWAIT) 探测窗口的首尾两页 (打开文件缓存中的热点文件不探测)，已映射的文件用 mincore
+    2. 不在页缓存中时 不再发送，把 (文件, 区间, 连接) 交给独立的 I/O 线程：I/O 线程读入该区间 (阻塞在磁盘上的是 I/O 线程)，
+       完成后为连接重新注册 EPOLLOUT，事件循环再继续发送。一次慢的磁盘读取 只影响请求该文件的连接
+    3. 每次 sendfile 最多发送 IO_WINDOW 字节，大文件按窗口逐段检查、预读
+    4. I/O 线程持有 dup 出的 fd，连接在等待期间被关闭 (超时等) 时 取消重新注册；每个请求记录连接的预读序号，
+       只有序号未变时才重新注册，复用同一 fd、同一连接对象的新连接 不会被旧请求提前唤醒
+    5. 队列已满、I/O 线程未启动、内核不支持 RWF_NOWAIT 时 退回直接发送
+*/
+
+#ifndef IO_READER_H
+#define IO_READER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <atomic>
+#include <list>
+
+#include "locker.h"
+
+#define IO_WINDOW (512 << 10)      // 每次 sendfile 与驻留检查的最大长度
+#define IO_READER_THREADS 2        // I/O 线程数量
+#define IO_QUEUE_MAX 1024          // 等待预读的最大请求数
+
+class http_conn;
+
+class io_reader
+{
+public:
+    // C++11 之后，使用局部静态变量 懒汉模式 无需加锁处理
+    static io_reader *getInstance()
+    {
+        static io_reader instance;
+        return &instance;
+    }
+
+    bool start();                   // 启动 I/O 线程
+    void stop();                    // 通知 I/O 线程退出，并等待其结束
+    static void *worker(void *arg); // 线程入口函数，调用 run()
+
+    // 文件区间 是否在页缓存中 (不阻塞，只探测首尾两页)。无法判断时视为在页缓存中
+    static bool resident(int fd, off_t offset, size_t len);
+    // 映射区间 是否在页缓存中 (不阻塞)
+    static bool resident(const char *addr, size_t len);
+
+    // 预读 fd 的 [offset, offset + len)，完成后为 conn 重新注册 EPOLLOUT。
+    // 调用者先递增 conn->m_io_seq、再设置 conn->m_io_wait。返回假表示未提交 (调用者直接发送)
+    bool submit(http_conn *conn, int fd, off_t offset, size_t len);
+
+    // 连接关闭前调用 (无论是否在等待)：之后不再为该连接重新注册事件
+    void cancel(http_conn *conn);
+
+    // 统计有变化时 写入日志
+    void report();
+
+private:
+    io_reader();
+    ~io_reader();
+
+    // 一个预读请求
+    struct job
+    {
+        http_conn *conn; // 等待的连接
+        int epfd;        // 连接所在的 epoll
+        int sockfd;      // 连接的 socket
+        unsigned seq;    // 提交时 连接的预读序号
+        int fd;          // dup 出的文件 fd (I/O 线程负责关闭)
+        off_t offset;    // 预读区间
+        size_t len;
+        long long queued; // 提交时间 (纳秒)
+    };
+
+    void run(); // I/O 线程主体
+
+private:
+    std::list<job> m_jobs;                  // 请求队列
+    locker m_lock;                          // 保护 队列 与 连接的等待标记
+    sem m_sem;                              // 队列中的请求数
+    bool m_stop;                            // 是否退出
+    pthread_t m_threads[IO_READER_THREADS]; // I/O 线程
+    int m_thread_count;                     // 已启动的 I/O 线程数
+
+    std::atomic<long long> m_submitted; // 提交的预读次数
+    std::atomic<long long> m_bytes;     // 预读的字节数
+    std::atomic<long long> m_wait_ns;   // 从提交到完成的 总耗时
+    std::atomic<long long> m_max_ns;    // 从提交到完成的 最大耗时
+    long long m_reported;               // 上次写入日志时的 提交次数
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*
+文件发送策略：
+
+    按文件大小与访问热度，为每个缓存的文件选择发送方式：
+    1. IO_READ     : 小文件加载时读入内存，与头部一起 writev。拷贝一次的代价低于建立映射，且不再占用 fd
+    2. IO_MMAP     : 中等大小的热点文件 mmap + MAP_POPULATE，由工作线程在加载时预先产生缺页，
+                     事件循环线程 writev 时不再触发缺页；流水线中多个响应可合并为一次 writev
+    3. IO_SENDFILE : 大文件与冷文件 sendfile 零拷贝，不占用地址空间
+    冷的中等文件先用 sendfile，命中次数达到 hot_hits 后 再建立映射 (只升级一次)。
+    阈值可在启动时设置，默认值来自 bench/io_bench.cpp 的测试结果：单个响应 16KB 以上 sendfile 最快，
+    流水线批量发送时 16KB 以下的文件合并为一次 writev 更快
+*/
+
+#ifndef IO_STRATEGY_H
+#define IO_STRATEGY_H
+
+// 发送方式
+enum IO_STRATEGY
+{
+    IO_READ = 0, // 读入内存
+    IO_MMAP,     // mmap 映射
+    IO_SENDFILE, // sendfile 零拷贝
+    IO_COUNT
+};
+
+// 策略选择方式，取值与 http_conn::SEND_MODE 相同
+enum IO_POLICY
+{
+    IO_POLICY_MMAP = 0, // 所有文件 mmap (不预先缺页)
+    IO_POLICY_SENDFILE, // 所有文件 sendfile
+    IO_POLICY_AUTO      // 按大小与热度选择
+};
+
+#define IO_READ_MAX (8LL << 10)  // 默认 不超过该大小的文件读入内存
+#define IO_MMAP_MAX (32LL << 10) // 默认 不超过该大小的热点文件 mmap，更大的文件 sendfile
+#define IO_HOT_HITS 8            // 默认 命中多少次后视为热点文件
+
+static const char *const io_names[IO_COUNT] = {"read", "mmap", "sendfile"};
+
+// 策略阈值
+struct io_thresholds
+{
+    long long read_max; // 读入内存的最大文件
+    long long mmap_max; // mmap 的最大文件
+    int hot_hits;       // 热点文件的命中次数
+};
+
+// 按 策略选择方式、文件大小、已命中次数 选择发送方式
+inline int choose_io(int policy, long long size, int hits, const io_thresholds &t)
+{
+    if (policy == IO_POLICY_MMAP)
+    {
+        return size > 0 ? IO_MMAP : IO_SENDFILE;
+    }
+    if (policy == IO_POLICY_SENDFILE || size <= 0)
+    {
+        return IO_SENDFILE;
+    }
+    if (size <= t.read_max)
+    {
+        return IO_READ;
+    }
+    if (size <= t.mmap_max && hits >= t.hot_hits)
+    {
+        return IO_MMAP;
+    }
+    return IO_SENDFILE;
+}
+
+#endif
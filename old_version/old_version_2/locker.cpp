@@ -1,3 +1,8 @@
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include "locker.h"
 
 // 构造函数 初始化互斥锁变量
@@ -114,3 +119,61 @@ bool sem::post()
 {
     return sem_post(&m_sem) == 0;
 }
+
+//---------------------------
+
+// futex 系统调用 封装
+static long futex(std::atomic<int> *addr, int op, int val)
+{
+    return syscall(SYS_futex, (int *)addr, op, val, NULL, NULL, 0);
+}
+
+// 构造函数
+event_count::event_count() : m_seq(0), m_waiters(0) {}
+
+// 登记为等待者，返回当前通知序号
+int event_count::prepare_wait()
+{
+    m_waiters.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst); // 登记 先于 调用者再次检查条件
+    return m_seq.load(std::memory_order_seq_cst);
+}
+
+// 条件已满足，取消等待
+void event_count::cancel_wait()
+{
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// 通知序号仍为 key 时休眠，直到被唤醒
+void event_count::wait(int key)
+{
+    // 序号已改变 说明期间有通知，futex 会立即返回
+    while (m_seq.load(std::memory_order_acquire) == key)
+    {
+        futex(&m_seq, FUTEX_WAIT_PRIVATE, key);
+    }
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// 唤醒一个 等待线程
+void event_count::notify_one()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst); // 条件修改 先于 读取等待者数量
+    if (m_waiters.load(std::memory_order_relaxed) > 0)
+    {
+        m_seq.fetch_add(1, std::memory_order_release);
+        futex(&m_seq, FUTEX_WAKE_PRIVATE, 1);
+    }
+}
+
+// 唤醒所有 等待线程
+void event_count::notify_all()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_waiters.load(std::memory_order_relaxed) > 0)
+    {
+        m_seq.fetch_add(1, std::memory_order_release);
+        futex(&m_seq, FUTEX_WAKE_PRIVATE, INT_MAX);
+    }
+}
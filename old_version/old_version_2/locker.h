@@ -4,11 +4,13 @@
 #include <pthread.h>   // 多线程  mutex_t cond_t
 #include <semaphore.h> // sem信号量
 #include <exception>   // 异常类
+#include <atomic>      // 原子变量
 
 // 线程同步机制封装类
 class locker;
 class cond;
 class sem;
+class event_count;
 
 // 互斥锁 类
 class locker
@@ -81,4 +83,34 @@ public:
     // 增加信号量（释放资源）V 操作
     bool post();
 };
+
+// 事件计数器 类 (基于 futex)
+// 用于无锁队列的空闲线程休眠/唤醒，用法：
+//   key = prepare_wait(); 再次检查条件; 满足则 cancel_wait()，否则 wait(key)
+// 通知方在修改条件之后调用 notify_one/notify_all，没有等待者时不产生系统调用
+class event_count
+{
+private:
+    std::atomic<int> m_seq;     // 通知序号，futex 等待的地址
+    std::atomic<int> m_waiters; // 等待者数量
+
+public:
+    // 构造函数
+    event_count();
+
+    // 登记为等待者，返回当前通知序号
+    int prepare_wait();
+
+    // 条件已满足，取消等待
+    void cancel_wait();
+
+    // 通知序号仍为 key 时休眠，直到被唤醒
+    void wait(int key);
+
+    // 唤醒一个 等待线程
+    void notify_one();
+
+    // 唤醒所有 等待线程
+    void notify_all();
+};
 #endif
\ No newline at end of file
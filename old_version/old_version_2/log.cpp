@@ -1,194 +1,986 @@
 #include <time.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <stdarg.h>
 #include <pthread.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <zlib.h>
 
 #include "log.h"
 
 int Log::m_close_flag = 1; // 关闭日志 标记
 
-Log::Log() : m_count(0),
-             m_is_async(false) {}
+// 线程局部：记录本线程的日志状态，线程退出时 析构函数交出未写出的缓冲区
+struct log_local
+{
+    log_thread *t;
+    ~log_local()
+    {
+        if (t)
+        {
+            Log::getInstance()->detach(t);
+            t = NULL;
+        }
+    }
+};
+static thread_local log_local s_local;
+
+// 单调时钟 毫秒
+static long long monotonic_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+// now 所在日期的下一天零点
+static time_t next_day(time_t now)
+{
+    struct tm my_tm;
+    localtime_r(&now, &my_tm);
+    my_tm.tm_hour = 0;
+    my_tm.tm_min = 0;
+    my_tm.tm_sec = 0;
+    my_tm.tm_mday += 1;
+    my_tm.tm_isdst = -1;
+    return mktime(&my_tm);
+}
+
+Log::Log() : m_split_lines(5000000), m_log_buf_size(8192), m_mode(LOG_TEXT), m_compress(false), m_fd(-1), m_part(0),
+             m_count(0), m_next_day(0), m_part_fd(-1), m_day_fd(-1), m_is_async(false), m_max_pending(0),
+             m_waiters(0), m_overflow(LOG_DROP_NEWEST), m_overflow_param(0), m_force(false), m_stop(false), m_dropped(0),
+             m_blocked(0), m_blocked_ns(0), m_reported_dropped(0), m_reported_blocked(0)
+{
+    dir_name[0] = '\0';
+    log_name[0] = '\0';
+    m_file_name[0] = '\0';
+}
 
 Log::~Log()
 {
-    if (m_fp)
+    m_close_flag = 1;
+    if (m_is_async)
+    {
+        // 通知写日志线程 写出所有缓冲区后退出
+        m_mutex.lock();
+        m_stop = true;
+        m_cond.signal();
+        m_space.boradcast();
+        m_mutex.unlock();
+        pthread_join(m_tid, NULL);
+        for (log_thread *t : m_threads)
+        {
+            delete t->cur;
+            delete t;
+        }
+        m_threads.clear();
+        s_local.t = NULL;
+    }
+    for (log_buffer *buf : m_free)
     {
-        fclose(m_fp);
+        delete buf;
     }
+    if (m_fd != -1)
+    {
+        close(m_fd);
+    }
+    discard(m_part_fd, m_part_name);
+    discard(m_day_fd, m_day_name);
 }
 
-// 日志文件，关闭日志标记， 日志缓冲区大小，日志最大行数，最长日志阻塞队列大小
-// 同步不需要设置 阻塞队列大小，  异步 需要设置
-bool Log::init(const char *f_name, int close_log, int log_buf_size, int split_lines, int max_queue_size)
+// 日志文件，关闭日志标记， 一行日志的最大长度，日志最大行数，异步时 最多积压的缓冲区数量，日志模式，是否压缩写完的文件
+// 同步不需要设置 积压数量，  异步 需要设置。同步时 只支持 LOG_TEXT
+bool Log::init(const char *f_name, int close_log, int log_buf_size, int split_lines, int max_queue_size, int mode,
+               bool compress)
 {
-    // 如果 堵塞队列大小为0 表示同步更新日志。  不为0，表示异步更新日志。
+    m_mode = max_queue_size >= 1 ? mode : LOG_TEXT;
+    m_compress = compress;
+    m_log_buf_size = log_buf_size < 64 ? 64 : (log_buf_size > LOG_BUFFER_SIZE ? LOG_BUFFER_SIZE : log_buf_size);
+    m_split_lines = split_lines > 0 ? split_lines : 5000000;
 
-    if (max_queue_size >= 1)
+    const char *p = strrchr(f_name, '/'); // 返回 f_name 中最后一次出现字符 '/' 的位置,如果未找到该值，则函数返回一个空指针。
+    if (p == NULL)                        // 找不到 说明日志在当前文件夹下
+    {
+        snprintf(log_name, sizeof(log_name), "%s", f_name);
+    }
+    else
     {
-        m_is_async = true;                                          // 表示 执行 异步 日志
-        m_log_queue = new Block_queue<std::string>(max_queue_size); // 申请 阻塞队列
-        pthread_t tid;                                              // 日志线程 id
+        // 找 到 说明日志在 当前文件夹的 子目录中。 路径 (包含 '/') 与 文件名 分别保存
+        snprintf(log_name, sizeof(log_name), "%s", p + 1);
+        snprintf(dir_name, sizeof(dir_name), "%.*s", (int)(p + 1 - f_name), f_name);
+    }
+    if (m_mode == LOG_BINARY)
+    {
+        strncat(log_name, ".bin", sizeof(log_name) - strlen(log_name) - 1); // 二进制日志 加后缀
+    }
 
-        pthread_create(&tid, NULL, async_write, NULL); // flush_log_thread 做为回调函数，表示创建线程 异步写入日志。
+    time_t t = time(NULL);        // 获取当期系统时间
+    localtime_r(&t, &m_file_tm); // time_t 转化为 格式化时间
 
-        // pthread_detach(tid); // 设置线程分离
+    // 日志文件名 全称 : 路径/年_月_日_文件名
+    make_name(m_file_name, sizeof(m_file_name), m_file_tm, 0);
+
+    m_next_day = next_day(t);      // 当天时间更新
+    m_fd = open_file(m_file_name); // 打开日志文件
+    if (m_fd == -1)
+    {
+        return false;
     }
 
-    if (max_queue_size == 0)
+    // 如果 积压数量为0 表示同步更新日志。  不为0，表示异步更新日志。
+    if (max_queue_size >= 1)
+    {
+        m_is_async = true; // 表示 执行 异步 日志
+        m_max_pending = max_queue_size;
+        if (pthread_create(&m_tid, NULL, async_write, NULL) != 0) // 创建线程 异步写入日志。
+        {
+            m_is_async = false;
+            m_mode = LOG_TEXT;
+        }
+    }
+    else
     {
         printf("同步 写日志 >>> \n");
     }
-    // 其他设置  同步 异步 都需要 初始化的参数
     m_close_flag = close_log;
-    m_log_buf_size = log_buf_size;
-    m_buff = new char[m_log_buf_size]; // 申请缓冲区空间
-    memset(m_buff, '\0', m_log_buf_size);
-    m_split_lines = split_lines;
+    return true;
+}
 
-    time_t t = time(NULL);             // 获取当期系统时间
-    struct tm *sys_tm = localtime(&t); // time_t 转化为 格式化时间
-    struct tm my_tm = *sys_tm;
+// 生成日志文件名：路径/年_月_日_文件名，同一天的第 part 个分文件加后缀 .part
+void Log::make_name(char *buf, int size, const struct tm &my_tm, long long part)
+{
+    if (part == 0)
+    {
+        snprintf(buf, size, "%s%d_%02d_%02d_%s", dir_name, my_tm.tm_year + 1900, my_tm.tm_mon + 1,
+                 my_tm.tm_mday, log_name);
+    }
+    else
+    {
+        snprintf(buf, size, "%s%d_%02d_%02d_%s.%lld", dir_name, my_tm.tm_year + 1900, my_tm.tm_mon + 1,
+                 my_tm.tm_mday, log_name, part);
+    }
+}
 
-    const char *p = strrchr(f_name, '/'); // 返回 f_name 中最后一次出现字符 '/' 的位置,如果未找到该值，则函数返回一个空指针。
-    char log_full_name[256] = {0};        // 日志文件名 全称
+// 打开日志文件 (追加写入)。二进制日志文件为空时 先写入文件头
+int Log::open_file(const char *name)
+{
+    int fd = open(name, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd != -1 && m_mode == LOG_BINARY && lseek(fd, 0, SEEK_END) == 0)
+    {
+        if (write(fd, LOG_MAGIC, LOG_MAGIC_SIZE) != LOG_MAGIC_SIZE)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
 
-    if (p == NULL) // 找不到 说明日志在当前文件夹下
+// 切换到 下一天的文件 (new_day) 或 当天的下一个分文件，优先使用预先打开的文件。调用者持有 m_file_lock
+// 打开失败时 继续写入当前文件
+void Log::swap_file(bool new_day, time_t now)
+{
+    char name[LOG_NAME_LEN];
+    struct tm my_tm = m_file_tm;
+    int part = m_part + 1;
+    int fd = -1;
+    if (new_day)
     {
-        // 日志文件名 形式 ：           年_月_日_文件名
-        snprintf(log_full_name, 255, "%d_%02d_%02d_%s", my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday, f_name);
+        localtime_r(&now, &my_tm);
+        part = 0;
+        m_next_day = next_day(now);
+        make_name(name, sizeof(name), my_tm, 0);
+        if (m_day_fd != -1 && strcmp(name, m_day_name) == 0)
+        {
+            fd = m_day_fd;
+            m_day_fd = -1;
+        }
+        // 昨天预先打开的分文件 不再使用
+        discard(m_part_fd, m_part_name);
+        m_part_fd = -1;
     }
     else
     {
-        // 找 到 说明日志在 当前文件夹的 子目录中。找到最后一个
-        strcpy(log_name, p + 1);                   // 不包含路径的文件名 copy 到log_name
-        strncpy(dir_name, f_name, p + 1 - f_name); // p + 1 为 文件名的第一个字符地址，f_name为整个路径的第一个字符地址。只差为路径名 包含 '/'
+        make_name(name, sizeof(name), my_tm, part);
+        if (m_part_fd != -1 && strcmp(name, m_part_name) == 0)
+        {
+            fd = m_part_fd;
+            m_part_fd = -1;
+        }
+    }
+    if (fd == -1)
+    {
+        fd = open_file(name);
+        if (fd == -1)
+        {
+            m_count = 0; // 避免每次写入都重试
+            return;
+        }
+    }
 
-        // 子目录下  log 全名 需要加入 路径/年_月_日_文件名
-        snprintf(log_full_name, 255, "%s%d_%02d_%02d_%s", dir_name, my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday, f_name);
+    close(m_fd);
+    m_fd = fd; // m_fd 更新为 新文件
+    m_count = 0;
+    m_part = part;
+    m_file_tm = my_tm;
+    if (m_compress)
+    {
+        // 写完的文件交给后台线程压缩 (线程负责释放文件名)
+        pthread_t tid;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        char *done = strdup(m_file_name);
+        if (pthread_create(&tid, &attr, compress_file, done) != 0)
+        {
+            free(done);
+        }
+        pthread_attr_destroy(&attr);
     }
+    snprintf(m_file_name, sizeof(m_file_name), "%s", name);
+    if (m_mode == LOG_BINARY)
+    {
+        write_all_defs();
+    }
+}
 
-    m_today = my_tm.tm_mday;          // 当天时间更新
-    m_fp = fopen(log_full_name, "a"); // 打开日志文件
-    if (m_fp == NULL)
+// 预先打开即将切换到的文件：当前文件写入 3/4 后打开下一个分文件，零点前 LOG_PREOPEN_SEC 秒打开下一天的文件
+void Log::prepare(time_t now)
+{
+    if (m_part_fd == -1 && m_count >= m_split_lines - m_split_lines / 4)
     {
-        // printf("未找到日志文件。\n");
-        return false;
+        make_name(m_part_name, sizeof(m_part_name), m_file_tm, m_part + 1);
+        m_part_fd = open_file(m_part_name);
+    }
+    if (m_day_fd == -1 && now >= m_next_day - LOG_PREOPEN_SEC)
+    {
+        struct tm my_tm;
+        time_t day = m_next_day;
+        localtime_r(&day, &my_tm);
+        make_name(m_day_name, sizeof(m_day_name), my_tm, 0);
+        m_day_fd = open_file(m_day_name);
     }
-    // printf("找到日志文件。\n");
-    return true;
 }
 
-// 日志 生成函数 (异步 产生日志 加入阻塞队列， 同步情况下直接写入日志)
-void Log::write_log(int level, const char *fromat, ...)
+// 关闭未使用的预先打开的文件，其中没有日志时删除
+void Log::discard(int fd, const char *name)
 {
-    // printf("执行 write_log.\n");
-    struct timeval now = {0, 0};
-    gettimeofday(&now, NULL); // 获取当前时间
+    if (fd == -1)
+    {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size <= (m_mode == LOG_BINARY ? LOG_MAGIC_SIZE : 0))
+    {
+        unlink(name);
+    }
+    close(fd);
+}
 
-    time_t t = now.tv_sec; // 当前秒数
-    struct tm *sys_tm = localtime(&t);
-    struct tm my_tm = *sys_tm;
+// 后台压缩线程：把写完的日志文件压缩为 name.gz (先写入临时文件再改名)，成功后删除原文件
+void *Log::compress_file(void *arg)
+{
+    char *name = (char *)arg;
+    char gz_name[LOG_NAME_LEN + 8], tmp_name[LOG_NAME_LEN + 8];
+    snprintf(gz_name, sizeof(gz_name), "%s.gz", name);
+    snprintf(tmp_name, sizeof(tmp_name), "%s.gz.tmp", name);
+
+    bool ok = false;
+    int fd = open(name, O_RDONLY | O_CLOEXEC);
+    gzFile gz = fd == -1 ? NULL : gzopen(tmp_name, "wb6");
+    if (gz != NULL)
+    {
+        char buf[1 << 16];
+        ssize_t n;
+        ok = true;
+        while ((n = read(fd, buf, sizeof(buf))) > 0)
+        {
+            if (gzwrite(gz, buf, n) != n)
+            {
+                ok = false;
+                break;
+            }
+        }
+        ok = gzclose(gz) == Z_OK && ok && n == 0;
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    if (ok && rename(tmp_name, gz_name) == 0)
+    {
+        unlink(name);
+    }
+    else
+    {
+        unlink(tmp_name);
+    }
+    free(name);
+    return NULL;
+}
 
-    char s[16] = {0};
+// 注册一个调用点的格式，返回格式编号
+int Log::register_format(int level, const char *format, const char *sig)
+{
+    log_def def = {level, format, sig};
+    m_mutex.lock();
+    int id = m_formats.size();
+    m_formats.push_back(def);
+    m_mutex.unlock();
+    return id;
+}
 
-    // 加入 level 信息到 s 中
-    switch (level)
+// 取一块空闲缓冲区
+log_buffer *Log::take_free()
+{
+    log_buffer *buf = NULL;
+    m_mutex.lock();
+    if (!m_free.empty())
     {
-    case 0:
-        stpcpy(s, "[debug]:");
-        break;
-    case 1:
-        stpcpy(s, "[info]:");
-        break;
-    case 2:
-        stpcpy(s, "[warn]:");
-        break;
-    case 3:
-        stpcpy(s, "[erro]:");
-        break;
-    default:
-        stpcpy(s, "[erro]:");
-        break;
+        buf = m_free.back();
+        m_free.pop_back();
     }
+    m_mutex.unlock();
+    if (buf == NULL)
+    {
+        buf = new log_buffer;
+    }
+    buf->len = 0;
+    buf->lines = 0;
+    buf->sampled = 0;
+    return buf;
+}
 
-    // 查看 当前日志 是否为最新文件 并 可以写入
+// 回收已写入文件的缓冲区，超过 LOG_FREE_MAX 的部分释放
+void Log::recycle(std::vector<log_buffer *> &bufs)
+{
     m_mutex.lock();
-    ++m_count; // 日志行数增加
+    while (!bufs.empty() && m_free.size() < LOG_FREE_MAX)
+    {
+        m_free.push_back(bufs.back());
+        bufs.pop_back();
+    }
+    m_mutex.unlock();
+    for (log_buffer *buf : bufs)
+    {
+        delete buf;
+    }
+    bufs.clear();
+}
+
+// 按日志模式 把一批缓冲区写入文件：文本直接写入，二进制先写入新出现的格式定义，延迟格式化的记录先格式化
+void Log::write_batch(log_buffer **bufs, int count)
+{
+    if (m_mode == LOG_DEFERRED)
+    {
+        format_records(bufs, count);
+        return;
+    }
+    m_file_lock.lock();
+    if (m_mode == LOG_BINARY)
+    {
+        write_defs(bufs, count);
+    }
+    write_locked(bufs, count);
+    m_file_lock.unlock();
+}
+
+// 把一条定义记录 (记录头 + 级别 + 签名 + '\0' + 格式串 + '\0') 加入 defs，缓冲区不足时 先写入文件。调用者持有 m_file_lock
+void Log::append_def(log_buffer *&defs, uint32_t id, const log_def &def)
+{
+    size_t sig_len = strlen(def.sig) + 1;
+    size_t fmt_len = strlen(def.format) + 1;
+    log_record d;
+    d.id = id | LOG_DEF_FLAG;
+    d.size = sizeof(d) + 1 + sig_len + fmt_len;
+    d.ns = 0;
+    if (d.size > LOG_BUFFER_SIZE)
+    {
+        return;
+    }
+    if (defs == NULL)
+    {
+        defs = take_free();
+    }
+    else if (LOG_BUFFER_SIZE - defs->len < (int)d.size)
+    {
+        struct iovec iv = {defs->data, (size_t)defs->len};
+        writev_all(&iv, 1);
+        defs->len = 0;
+    }
+    char *p = defs->data + defs->len;
+    memcpy(p, &d, sizeof(d));
+    p[sizeof(d)] = (char)def.level;
+    memcpy(p + sizeof(d) + 1, def.sig, sig_len);
+    memcpy(p + sizeof(d) + 1 + sig_len, def.format, fmt_len);
+    defs->len += d.size;
+    if (id >= m_defined.size())
+    {
+        m_defined.resize(id + 1, 0);
+    }
+    m_defined[id] = 1;
+}
 
-    // 如果当前文件日志 达到最大行数，或者 当前文件日志 时间 不匹配。
-    if (m_today != my_tm.tm_mday || m_count % m_split_lines == 0)
+// 写入 append_def 积累的定义记录 (不计入行数)
+void Log::flush_defs(log_buffer *defs)
+{
+    if (defs)
     {
-        // printf("执行 write_log 更新文件名.\n");
-        char newLogName[256] = {0};
-        fflush(m_fp); // 强制刷新 当前日志文件
-        fclose(m_fp); // 并关闭 当前日志文件
-        char tail[16] = {0};
+        struct iovec iv = {defs->data, (size_t)defs->len};
+        writev_all(&iv, 1);
+        std::vector<log_buffer *> used(1, defs);
+        recycle(used);
+    }
+}
 
-        // 获取 新的文件名
-        snprintf(tail, 16, "%d_%02d_%02d_", my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday);
+// 写入 bufs 中出现、但当前文件中还没有定义的格式编号。调用者持有 m_file_lock
+void Log::write_defs(log_buffer **bufs, int count)
+{
+    m_mutex.lock();
+    std::vector<log_def> formats = m_formats; // 定义只增不改，复制后在锁外使用
+    m_mutex.unlock();
 
-        // 日期不匹配时，将新的文件名 写入到 newLog
-        if (m_today != my_tm.tm_mday)
+    log_buffer *defs = NULL;
+    for (int i = 0; i < count; ++i)
+    {
+        log_record r;
+        for (int off = 0; off + (int)sizeof(r) <= bufs[i]->len; off += r.size)
         {
-            snprintf(newLogName, 255, "%s%s%s", dir_name, tail, log_name);
-            m_today = my_tm.tm_mday; // 更新当前 日期
-            m_count = 0;             // 当前文件行数，一个新文件，重新从0计数
+            memcpy(&r, bufs[i]->data + off, sizeof(r));
+            if (r.size < sizeof(r))
+            {
+                break; // 记录损坏
+            }
+            if (r.id < formats.size() && (r.id >= m_defined.size() || !m_defined[r.id]))
+            {
+                append_def(defs, r.id, formats[r.id]);
+            }
+        }
+    }
+    flush_defs(defs);
+}
+
+// 切换到新文件后 写入目前注册的全部格式定义。调用者持有 m_file_lock
+void Log::write_all_defs()
+{
+    m_mutex.lock();
+    std::vector<log_def> formats = m_formats;
+    m_mutex.unlock();
+
+    m_defined.clear();
+    log_buffer *defs = NULL;
+    for (size_t id = 0; id < formats.size(); ++id)
+    {
+        append_def(defs, id, formats[id]);
+    }
+    flush_defs(defs);
+}
+
+// 把延迟格式化的记录 格式化为文本行，写入文件
+void Log::format_records(log_buffer **bufs, int count)
+{
+    m_mutex.lock();
+    std::vector<log_def> formats = m_formats;
+    m_mutex.unlock();
+
+    log_clock clock; // 同一批记录 大多在同一秒内
+    std::vector<log_buffer *> out(1, take_free());
+    for (int i = 0; i < count; ++i)
+    {
+        log_record r;
+        for (int off = 0; off + (int)sizeof(r) <= bufs[i]->len; off += r.size)
+        {
+            memcpy(&r, bufs[i]->data + off, sizeof(r));
+            if (r.size < sizeof(r) || off + r.size > (uint32_t)bufs[i]->len)
+            {
+                break; // 记录损坏
+            }
+            if (r.id >= formats.size())
+            {
+                continue;
+            }
+            log_buffer *o = out.back();
+            if (LOG_BUFFER_SIZE - o->len < m_log_buf_size)
+            {
+                o = take_free();
+                out.push_back(o);
+            }
+            const log_def &def = formats[r.id];
+            ++o->lines;
+            o->len += log_format_record(o->data + o->len, m_log_buf_size, clock, r, bufs[i]->data + off + sizeof(r),
+                                        def.level, def.format, def.sig);
+        }
+    }
+    write_file(out.data(), out.size());
+    recycle(out);
+}
+
+// 把缓冲区写入当前日志文件
+void Log::write_file(log_buffer **bufs, int count)
+{
+    m_file_lock.lock();
+    write_locked(bufs, count);
+    m_file_lock.unlock();
+}
+
+// 把缓冲区写入当前日志文件：攒够 IOV_MAX 块 一次 writev。调用者持有 m_file_lock
+// 写入前检查日期；当前文件的行数将超过 m_split_lines 时，在该行处拆开缓冲区，写完前一段后切换文件
+void Log::write_locked(log_buffer **bufs, int count)
+{
+    struct iovec iv[IOV_MAX];
+    int n = 0;
+    time_t now = time(NULL);
+    if (now >= m_next_day)
+    {
+        swap_file(true, now);
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        const char *data = bufs[i]->data;
+        int len = bufs[i]->len;
+        long long lines = bufs[i]->lines;
+        while (len > 0)
+        {
+            long long room = m_split_lines - m_count;
+            int cut = lines <= room ? len : split_point(data, len, room);
+            if (cut > 0)
+            {
+                if (n == IOV_MAX)
+                {
+                    writev_all(iv, n);
+                    n = 0;
+                }
+                iv[n].iov_base = (void *)data;
+                iv[n].iov_len = cut;
+                ++n;
+            }
+            if (lines <= room)
+            {
+                m_count += lines;
+                break;
+            }
+            // 当前文件已满：写出之前的部分，切换到下一个分文件
+            writev_all(iv, n);
+            n = 0;
+            m_count += room;
+            data += cut;
+            len -= cut;
+            lines -= room;
+            swap_file(false, now);
+        }
+    }
+    writev_all(iv, n);
+    prepare(now);
+}
+
+// 缓冲区中 前 lines 行 (二进制时为记录) 的字节数
+int Log::split_point(const char *data, int len, long long lines)
+{
+    int off = 0;
+    while (lines > 0 && off < len)
+    {
+        if (m_mode == LOG_BINARY)
+        {
+            log_record r;
+            memcpy(&r, data + off, sizeof(r));
+            off += r.size;
         }
         else
         {
-            // 如果是达到最大行数， 则当前日期，创建第二个文件。m_count / m_split_lines;
-            snprintf(newLogName, 255, "%s%s%s.%lld", dir_name, tail, log_name, m_count / m_split_lines);
+            const char *end = (const char *)memchr(data + off, '\n', len - off);
+            off = end ? end - data + 1 : len;
         }
-        m_fp = fopen(newLogName, "a"); // m_fp 更新为 新文件指针
+        --lines;
     }
+    return off < len ? off : len;
+}
 
-    m_mutex.unlock();
+// writev 全部数据，部分写入时 调整 iov 继续。调用者持有 m_file_lock
+void Log::writev_all(struct iovec *iv, int n)
+{
+    while (n > 0)
+    {
+        ssize_t ret = writev(m_fd, iv, n);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return; // 写入失败 (磁盘已满等) 丢弃这批日志
+        }
+        while (n > 0 && (size_t)ret >= iv->iov_len)
+        {
+            ret -= iv->iov_len;
+            ++iv;
+            --n;
+        }
+        if (n > 0)
+        {
+            iv->iov_base = (char *)iv->iov_base + ret;
+            iv->iov_len -= ret;
+        }
+    }
+}
 
-    va_list args;
-    va_start(args, fromat);
+// 本线程的日志状态，首次调用时 分配缓冲区并注册到写日志线程
+log_thread *Log::local()
+{
+    log_thread *t = s_local.t;
+    if (t == NULL)
+    {
+        t = new log_thread;
+        t->cur = take_free();
+        t->dead = false;
+        if (m_is_async)
+        {
+            m_mutex.lock();
+            m_threads.push_back(t);
+            m_mutex.unlock();
+        }
+        s_local.t = t;
+    }
+    return t;
+}
+
+// 线程退出：异步时 交出未写出的缓冲区并标记，由写日志线程释放 log_thread。
+// 空缓冲区经 recycle 放回空闲表，线程频繁创建退出时 空闲表同样受 LOG_FREE_MAX 限制
+void Log::detach(log_thread *t)
+{
+    if (!m_is_async)
+    {
+        delete t->cur;
+        delete t;
+        return;
+    }
+    std::vector<log_buffer *> empty;
+    t->lock.lock();
+    m_mutex.lock();
+    if (t->cur->len > 0)
+    {
+        m_full.push_back(t->cur);
+    }
+    else
+    {
+        empty.push_back(t->cur);
+    }
+    t->cur = NULL;
+    t->dead = true;
+    m_cond.signal();
+    m_mutex.unlock();
+    t->lock.unlock();
+    recycle(empty);
+}
 
-    // 正式 生成日志
-    std::string log_str;
+// 交出本线程写满的缓冲区，换上空闲缓冲区。持有 t->lock 时调用
+// 积压达到上限时 按 m_overflow 处理，返回时 t->cur 至少有 need 字节的空间
+void Log::hand_off(log_thread *t, int need)
+{
     m_mutex.lock();
+    if (m_full.size() >= (size_t)m_max_pending && m_overflow == LOG_BLOCK && !m_stop)
+    {
+        // 等待写日志线程取走积压的缓冲区
+        int ms = m_overflow_param > 0 ? m_overflow_param : LOG_BLOCK_MS;
+        struct timespec start, deadline;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += ms / 1000;
+        deadline.tv_nsec += (ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            ++deadline.tv_sec;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        ++m_waiters;
+        while (m_full.size() >= (size_t)m_max_pending && !m_stop)
+        {
+            if (!m_space.timewait(m_mutex.get(), deadline))
+            {
+                break; // 超时
+            }
+        }
+        --m_waiters;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        m_blocked.fetch_add(1, std::memory_order_relaxed);
+        m_blocked_ns.fetch_add((end.tv_sec - start.tv_sec) * 1000000000LL + end.tv_nsec - start.tv_nsec,
+                               std::memory_order_relaxed);
+    }
+    if (m_full.size() < (size_t)m_max_pending)
+    {
+        m_full.push_back(t->cur);
+        m_cond.signal();
+        m_mutex.unlock();
+        t->cur = take_free();
+        return;
+    }
 
-    // printf("执行 write_log 生成日志.\n");
-    // 写入 具体的 时间 + 日志类型  (年-月-日 时-分-秒-毫秒 [debug] [info] [erro] 等)
-    // 标准化 日志行 前缀
-    int n = snprintf(m_buff, 48, "%d-%02d-%02d %02d:%02d:%02d.%03ld %s",
-                     my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday,
-                     my_tm.tm_hour, my_tm.tm_min, my_tm.tm_sec, now.tv_usec / 1000, s);
+    // 写日志线程跟不上
+    log_buffer *oldest = NULL;
+    if (m_overflow == LOG_DROP_OLDEST)
+    {
+        oldest = m_full.front(); // 积压的缓冲区 最多 m_max_pending 块
+        m_full.erase(m_full.begin());
+        m_full.push_back(t->cur);
+        m_cond.signal();
+    }
+    m_mutex.unlock();
 
-    // 写入 当前行 日志内容。  args 即传入的 可变参数。             vsnprintf 与 snprintf的不同之处就在于 一个接收可变参数，一个接收va_list
-    int m = vsnprintf(m_buff + n, m_log_buf_size - 1, fromat, args); // m_buff + n,为写入 日志行前缀 后的地址。
+    switch (m_overflow)
+    {
+    case LOG_OVERFLOW_WRITE:
+        write_batch(&t->cur, 1); // 本线程直接写入文件
+        t->cur->len = 0;
+        t->cur->lines = 0;
+        t->cur->sampled = 0;
+        break;
+    case LOG_DROP_OLDEST:
+        drop(oldest);
+        t->cur = oldest;
+        break;
+    case LOG_SAMPLE:
+        sample(t->cur);
+        if (LOG_BUFFER_SIZE - t->cur->len < need)
+        {
+            drop(t->cur); // 缓冲区中 全是抽样保留的行
+        }
+        break;
+    default:
+        drop(t->cur); // LOG_DROP_NEWEST，LOG_BLOCK 等待超时
+        break;
+    }
+}
 
-    m_buff[m + n] = '\n'; // 手动在 日志行 末尾置 换行符。
-    m_buff[m + n + 1] = '\0';
-    log_str = m_buff; // 当前 日志行 赋值给 log_str;
+// 丢弃缓冲区中的日志，计入丢弃的行数
+void Log::drop(log_buffer *buf)
+{
+    m_dropped.fetch_add(buf->lines, std::memory_order_relaxed);
+    buf->len = 0;
+    buf->lines = 0;
+    buf->sampled = 0;
+}
+
+// 缓冲区中 还未抽样的行 (记录) 每 m_overflow_param 行保留一行，保留的行前移，其余计入丢弃的行数
+void Log::sample(log_buffer *buf)
+{
+    int step = m_overflow_param > 0 ? m_overflow_param : LOG_SAMPLE_STEP;
+    char *data = buf->data;
+    int out = buf->sampled;
+    int index = 0;
+    int kept = 0;
+    for (int off = buf->sampled; off < buf->len; ++index)
+    {
+        int size = buf->len - off;
+        if (m_mode == LOG_TEXT)
+        {
+            const char *end = (const char *)memchr(data + off, '\n', size);
+            if (end)
+            {
+                size = end - (data + off) + 1;
+            }
+        }
+        else
+        {
+            log_record r;
+            memcpy(&r, data + off, sizeof(r));
+            if (r.size >= sizeof(r) && r.size <= (uint32_t)size)
+            {
+                size = r.size;
+            }
+        }
+        if (index % step == 0)
+        {
+            memmove(data + out, data + off, size);
+            out += size;
+            ++kept;
+        }
+        off += size;
+    }
+    m_dropped.fetch_add(index - kept, std::memory_order_relaxed);
+    buf->lines -= index - kept;
+    buf->len = out;
+    buf->sampled = out;
+}
 
+// 积压达到上限时的处理方式
+void Log::set_overflow(int policy, int param)
+{
+    m_mutex.lock();
+    m_overflow = policy >= LOG_OVERFLOW_WRITE && policy <= LOG_SAMPLE ? policy : LOG_DROP_NEWEST;
+    m_overflow_param = param;
     m_mutex.unlock();
+}
 
-    // 如果为异步 并且 阻塞队列不满 则加入阻塞队列
-    if (m_is_async && !m_log_queue->isFull())
+// 输出积压统计：丢弃的行数、等待的次数与平均等待时间 (有变化时)
+void Log::report()
+{
+    long long dropped = m_dropped.load(std::memory_order_relaxed);
+    long long blocked = m_blocked.load(std::memory_order_relaxed);
+    if (dropped == m_reported_dropped && blocked == m_reported_blocked)
     {
-        // printf("执行 write_log 加入异步日志 队列.\n");
-        m_log_queue->push(log_str);
+        return;
     }
-    else
-    { // 同步 情况下 直接 fputs 写入 m_fp
-        m_mutex.lock();
-        fputs(log_str.c_str(), m_fp);
-        m_mutex.unlock();
+    long long waits = blocked - m_reported_blocked;
+    long long wait_ns = m_blocked_ns.exchange(0, std::memory_order_relaxed);
+    LOG_WARN("log overflow: dropped=%lld lines (+%lld), blocked=%lld (+%lld), avg block=%.2f ms.", dropped,
+             dropped - m_reported_dropped, blocked, waits, waits > 0 ? wait_ns / 1e6 / waits : 0.0);
+    m_reported_dropped = dropped;
+    m_reported_blocked = blocked;
+}
+
+// 日志 生成函数 (异步 写入本线程缓冲区， 同步情况下直接写入日志)
+void Log::write_log(int level, const char *fromat, ...)
+{
+    struct timeval now = {0, 0};
+    gettimeofday(&now, NULL); // 获取当前时间
+
+    // 本线程的时间戳缓存：秒数变化时 才重新计算本地时间
+    log_thread *lt = local();
+    lt->clock.update(now.tv_sec);
+
+    lt->lock.lock();
+    if (LOG_BUFFER_SIZE - lt->cur->len < m_log_buf_size)
+    {
+        hand_off(lt, m_log_buf_size); // 剩余空间 不足一行的最大长度
     }
+    char *buf = lt->cur->data + lt->cur->len;
+
+    // 写入 具体的 时间 + 日志类型  (年-月-日 时-分-秒-毫秒 [debug] [info] [erro] 等)
+    // 标准化 日志行 前缀
+    int n = lt->clock.prefix(buf, now.tv_usec / 1000, level);
 
+    // 写入 当前行 日志内容。超过一行的最大长度时 截断
+    va_list args;
+    va_start(args, fromat);
+    int m = vsnprintf(buf + n, m_log_buf_size - n - 1, fromat, args);
     va_end(args);
+    if (m < 0)
+    {
+        m = 0;
+    }
+    else if (m > m_log_buf_size - n - 2)
+    {
+        m = m_log_buf_size - n - 2;
+    }
+    buf[n + m] = '\n'; // 手动在 日志行 末尾置 换行符。
+    lt->cur->len += n + m + 1;
+    ++lt->cur->lines;
+
+    if (!m_is_async)
+    {
+        // 同步 情况下 直接写入文件 (需要时 由本线程切换文件)
+        write_file(&lt->cur, 1);
+        lt->cur->len = 0;
+        lt->cur->lines = 0;
+    }
+    lt->lock.unlock();
 }
 
-// 强制刷新 写入文件流 缓冲区
+// 异步时 通知写日志线程 立即写出所有缓冲区
 void Log::flush(void)
 {
+    if (!m_is_async)
+    {
+        return; // 同步时 每行直接 write，没有缓冲
+    }
     m_mutex.lock();
-    fflush(m_fp); // 强制刷新 写入文件流 缓冲区
+    m_force = true;
+    m_cond.signal();
     m_mutex.unlock();
-}
\ No newline at end of file
+}
+
+// 写日志线程：等待写满的缓冲区 (最多等到下次收集)，距上次收集满 LOG_FLUSH_MS / flush / 退出时 再收集各线程未写满的缓冲区，
+// 一批写入文件。收集按时间进行，与是否有写满的缓冲区无关：某个线程持续写满缓冲区时，其他线程的零星日志同样按时落盘
+void Log::async_write_log()
+{
+    printf("异步写日志线程 已启动...\n");
+    std::vector<log_buffer *> batch;
+    std::vector<log_thread *> threads;
+    long long last_collect = monotonic_ms(); // 上次收集未写满缓冲区的时间
+    while (true)
+    {
+        m_mutex.lock();
+        long long wait_ms = last_collect + LOG_FLUSH_MS - monotonic_ms();
+        if (m_full.empty() && !m_force && !m_stop && wait_ms > 0)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += wait_ms / 1000;
+            deadline.tv_nsec += (wait_ms % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                ++deadline.tv_sec;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            m_cond.timewait(m_mutex.get(), deadline);
+        }
+        batch.swap(m_full); // 整体交换，生产者之后写入新的空队列
+        if (m_waiters > 0)
+        {
+            m_space.boradcast(); // 积压已取走 (LOG_BLOCK)
+        }
+        long long now = monotonic_ms();
+        bool collect = now - last_collect >= LOG_FLUSH_MS || m_force || m_stop;
+        bool stop = m_stop;
+        m_force = false;
+        if (collect)
+        {
+            threads = m_threads;
+            last_collect = now;
+        }
+        m_mutex.unlock();
+
+        // 收集未写满的缓冲区，移除已退出的线程
+        if (collect)
+        {
+            bool dead = false;
+            for (log_thread *t : threads)
+            {
+                t->lock.lock();
+                if (t->dead)
+                {
+                    dead = true;
+                }
+                else if (t->cur->len > 0)
+                {
+                    batch.push_back(t->cur);
+                    t->cur = take_free();
+                }
+                t->lock.unlock();
+            }
+            if (dead)
+            {
+                m_mutex.lock();
+                for (size_t i = 0; i < m_threads.size();)
+                {
+                    if (m_threads[i]->dead)
+                    {
+                        delete m_threads[i];
+                        m_threads[i] = m_threads.back();
+                        m_threads.pop_back();
+                    }
+                    else
+                    {
+                        ++i;
+                    }
+                }
+                m_mutex.unlock();
+            }
+        }
+
+        if (!batch.empty())
+        {
+            write_batch(batch.data(), batch.size());
+            recycle(batch);
+        }
+        if (stop)
+        {
+            break;
+        }
+    }
+}
@@ -3,6 +3,19 @@
 
     采用 单例模式(懒汉模式) 进行读写日志
     1. 也可以使用 双检测锁 + 类静态实例 实现懒汉模式
+    2. 异步模式采用 双缓冲 (muduo 方式)：每个线程把日志行格式化到自己的定长缓冲区 (线程局部，只有本线程与写日志线程使用)，
+       缓冲区写满后 整块交给写日志线程，并换上一块空闲缓冲区；写日志线程把积压的缓冲区一次 writev 写入文件。
+       写日志线程每 LOG_FLUSH_MS 收集一次各线程未写满的缓冲区，日志最多延迟这么久落盘
+    3. 不同线程的日志按缓冲区成批写入，文件中的行 只在同一线程内保持时间顺序
+    4. 同步模式 (max_queue_size 为 0) 格式化后直接 write 到文件
+    5. 按天 / 按行数切换文件 由写入文件的一方完成 (异步时为写日志线程)，调用 LOG_* 的线程不会等待切换：
+       缓冲区记录行数，写入时 在第 m_split_lines 行处拆开，前后两段分别写入两个文件；
+       下一个分文件 在当前文件写入 3/4 后预先打开，下一天的文件 在零点前 LOG_PREOPEN_SEC 秒预先打开，切换时只交换 fd。
+       可选 切换后由后台线程把写完的文件压缩为 .gz
+    6. 写日志线程跟不上、积压的缓冲区达到上限时 按 LOG_OVERFLOW 处理 (默认丢弃本线程写满的缓冲区)，
+       调用 LOG_* 的线程不再自己写文件；丢弃的行数、等待的次数与时间 计数，由 report 定时输出
+    7. 异步时可选 延迟格式化 (log_format.h)：LOG_* 只把 格式编号、时间戳、参数原始字节 写入本线程缓冲区，
+       由写日志线程格式化 (LOG_DEFERRED)，或直接写入二进制文件 由 bin/log_decode 离线解码 (LOG_BINARY)
 */
 
 #ifndef LOG_H
@@ -13,7 +26,57 @@
 #include <string>
 #include <stdarg.h>
 #include <pthread.h>
-#include "block_queue.h"
+#include <time.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <vector>
+
+#include "locker.h"
+#include "log_format.h"
+
+#define LOG_BUFFER_SIZE (64 << 10) // 每个线程 一块缓冲区的大小
+#define LOG_FLUSH_MS 1000          // 写日志线程 收集未写满缓冲区的间隔
+#define LOG_FREE_MAX 16            // 保留的空闲缓冲区数量上限
+#define LOG_PREOPEN_SEC 60         // 零点前多少秒 预先打开下一天的文件
+#define LOG_NAME_LEN 320           // 日志文件名 (路径 + 日期 + 文件名 + 分文件编号) 的最大长度
+#define LOG_BLOCK_MS 10            // LOG_BLOCK 默认 最长等待的毫秒数
+#define LOG_SAMPLE_STEP 8          // LOG_SAMPLE 默认 每多少行保留一行
+
+// 异步时 积压的缓冲区达到上限 (写日志线程跟不上) 的处理方式
+enum LOG_OVERFLOW
+{
+    LOG_OVERFLOW_WRITE = 0, // 调用线程直接写入文件 (原方式，请求线程等待磁盘)
+    LOG_DROP_NEWEST,        // 丢弃本线程写满的缓冲区
+    LOG_DROP_OLDEST,        // 丢弃最早积压的缓冲区，换给本线程使用
+    LOG_BLOCK,              // 等待写日志线程 最多若干毫秒，仍然积压时 丢弃本线程的缓冲区
+    LOG_SAMPLE              // 本线程缓冲区中 新写入的行 每若干行保留一行，腾出空间继续写入
+};
+
+// 日志缓冲区
+struct log_buffer
+{
+    int len;                     // 已写入的字节数
+    int lines;                   // 已写入的行数 (二进制时为记录数)
+    int sampled;                 // 已抽样的前缀字节数 (LOG_SAMPLE，之后的行还未抽样)
+    char data[LOG_BUFFER_SIZE];  // 日志行
+};
+
+// 每个线程的日志状态 (线程退出时 由写日志线程释放)
+struct log_thread
+{
+    locker lock;     // 保护 cur：本线程写入 与 写日志线程收集
+    log_buffer *cur; // 正在写入的缓冲区
+    bool dead;       // 线程已退出
+    log_clock clock; // 本线程的时间戳前缀缓存 (只有本线程使用)
+};
+
+// 一个调用点的格式定义
+struct log_def
+{
+    int level;          // 日志级别
+    const char *format; // 格式串 (字符串常量)
+    const char *sig;    // 参数类型签名 (静态存储)
+};
 
 // 日志类
 class Log
@@ -27,23 +90,69 @@ public:
         return &instance;
     }
 
-    // 异步写日志回调函数。取 阻塞队列日志 写入文件
-    static void *async_write(void *args)
+    // 异步写日志回调函数。取 写满的缓冲区 写入文件
+    static void *async_write(void *)
     {
-        // printf("调用 异步写日志函数\n");
-        Log::getInstance()->async_wirte_log();
-        // printf("调用成功\n");
+        Log::getInstance()->async_write_log();
+        return NULL;
     }
 
-    // 日志文件， 日志缓冲区大小，日志最大行数，最长日志阻塞队列大小
-    bool init(const char *f_name, int close_log, int log_buf_size = 8192, int split_lines = 5000000, int max_queue_size = 0);
+    // 日志文件， 日志缓冲区大小 (一行的最大长度)，日志最大行数，异步时 最多积压的缓冲区数量，日志模式 (LOG_MODE，仅异步有效)，
+    // 切换文件后 是否在后台压缩写完的文件
+    bool init(const char *f_name, int close_log, int log_buf_size = 8192, int split_lines = 5000000, int max_queue_size = 0,
+              int mode = LOG_TEXT, bool compress = false);
 
-    // 日志 生成函数 (异步 产生日志 加入阻塞队列， 同步情况下直接写入日志)
+    // 日志 生成函数 (异步 写入本线程缓冲区， 同步情况下直接写入日志)
     void write_log(int level, const char *fromat, ...);
 
-    // 强制刷新 写入文件流 缓冲区
+    // 注册一个调用点的 级别、格式串、参数类型签名，返回格式编号。每个调用点只调用一次
+    int register_format(int level, const char *format, const char *sig);
+
+    // 调用点的日志：文本模式 转给 write_log，否则写入二进制记录
+    template <typename... Args>
+    void write_record(int level, int id, const char *format, Args... args)
+    {
+        if (m_mode == LOG_TEXT)
+        {
+            write_log(level, format, args...);
+            return;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+
+        log_record r;
+        r.id = id;
+        r.size = sizeof(log_record) + (0 + ... + log_arg_size(args));
+        r.ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+
+        log_thread *lt = local();
+        lt->lock.lock();
+        if (LOG_BUFFER_SIZE - lt->cur->len < (int)r.size)
+        {
+            hand_off(lt, r.size);
+        }
+        char *p = lt->cur->data + lt->cur->len;
+        memcpy(p, &r, sizeof(r));
+        p += sizeof(r);
+        ((p = log_arg_put(p, args)), ...);
+        lt->cur->len += r.size;
+        ++lt->cur->lines;
+        lt->lock.unlock();
+    }
+
+    // 异步时 通知写日志线程 立即写出所有缓冲区
     void flush(void);
 
+    // 积压的缓冲区达到上限时的处理方式 (LOG_OVERFLOW)。param：LOG_BLOCK 为最长等待的毫秒数，LOG_SAMPLE 为每多少行保留一行，
+    // 不大于 0 时使用默认值
+    void set_overflow(int policy, int param = 0);
+
+    long long dropped() const { return m_dropped.load(std::memory_order_relaxed); } // 因积压丢弃的行数
+    long long blocked() const { return m_blocked.load(std::memory_order_relaxed); } // 因积压等待的次数
+
+    // 输出积压统计 (有变化时)
+    void report();
+
     static int m_close_flag; // 关闭日志 标记
 
 private:
@@ -52,63 +161,96 @@ private:
     virtual ~Log();
 
     // 异步写日志 函数
-    void *async_wirte_log()
-    {
-        // 日志线程 正在运行
-        printf("异步写日志线程 已启动...\n");
-        std::string single_log;
-        // 从阻塞队列中 去除一个日志 string, 写入文件
+    void async_write_log();
 
-        while (m_log_queue->pop(single_log))
-        {
-            // printf("取出日志，正在写入....");
-            // 队列中取出文件 。 加锁进行 写入文件
-            m_mutex.lock();
-            fputs(single_log.c_str(), m_fp); // 写入文件
-            m_mutex.unlock();
-            Log::getInstance()->flush(); // 刷新
-        }
-        // printf("暂无日志");
-    }
+    log_thread *local();                                                         // 本线程的日志状态 (首次调用时注册)
+    void detach(log_thread *t);                                                  // 线程退出：交出缓冲区，由写日志线程释放
+    void hand_off(log_thread *t, int need);                                      // 交出本线程写满的缓冲区，腾出 need 字节。持有 t->lock 时调用
+    void drop(log_buffer *buf);                                                  // 丢弃缓冲区中的日志 (计数)
+    void sample(log_buffer *buf);                                                // 未抽样的行 每 m_overflow_param 行保留一行
+    log_buffer *take_free();                                                     // 取一块空闲缓冲区
+    void recycle(std::vector<log_buffer *> &bufs);                               // 回收已写入文件的缓冲区
+    void write_batch(log_buffer **bufs, int count);                              // 按日志模式 把一批缓冲区写入文件
+    void write_file(log_buffer **bufs, int count);                               // 把缓冲区写入当前日志文件
+    void write_locked(log_buffer **bufs, int count);                             // 同上，按日期 / 行数切换文件。持有 m_file_lock
+    void writev_all(struct iovec *iv, int n);                                    // writev 全部数据。持有 m_file_lock
+    int split_point(const char *data, int len, long long lines);                 // 前 lines 行 (记录) 的字节数
+    void write_defs(log_buffer **bufs, int count);                               // 写入本文件中还未定义的格式编号。持有 m_file_lock
+    void write_all_defs();                                                       // 向新文件写入全部格式定义。持有 m_file_lock
+    void append_def(log_buffer *&defs, uint32_t id, const log_def &def);         // 加入一条定义记录。持有 m_file_lock
+    void flush_defs(log_buffer *defs);                                           // 写入并回收定义记录。持有 m_file_lock
+    void format_records(log_buffer **bufs, int count);                           // 把记录格式化为文本 写入文件
+    int open_file(const char *name);                                             // 打开日志文件，二进制文件为空时写入文件头
+    void swap_file(bool new_day, time_t now);                                    // 切换到下一天 / 下一个分文件。持有 m_file_lock
+    void prepare(time_t now);                                                    // 预先打开即将切换到的文件。持有 m_file_lock
+    void discard(int fd, const char *name);                                      // 关闭未使用的预先打开的文件，为空时删除
+    static void *compress_file(void *arg);                                       // 后台压缩线程：name -> name.gz
+    void make_name(char *buf, int size, const struct tm &my_tm, long long part); // 生成日志文件名
+
+    friend struct log_local;
 
 private:
-    char dir_name[128];                    // 日志路径名
-    char log_name[128];                    // 日志文件名
-    int m_split_lines;                     // 日志最大行数
-    int m_log_buf_size;                    // 日志缓冲区大小
-    long long m_count;                     // 日志行数记录
-    int m_today;                           // 日志按天进行分类 m_today 记录当前时间是哪一天
-    FILE *m_fp;                            // 打开的 log 文件指针
-    char *m_buff;                          // 缓冲区。
-    Block_queue<std::string> *m_log_queue; // 日志阻塞队列
-    bool m_is_async;                       // 是否同步 标志位
-    locker m_mutex;                        // 互斥锁
+    char dir_name[128];             // 日志路径名
+    char log_name[128];             // 日志文件名
+    int m_split_lines;              // 日志最大行数
+    int m_log_buf_size;             // 一行日志的最大长度
+    int m_mode;                     // 日志模式
+    bool m_compress;                // 切换后 后台压缩写完的文件
+
+    locker m_file_lock;             // 保护 以下成员：写入文件 与 切换文件
+    int m_fd;                       // 打开的 log 文件
+    char m_file_name[LOG_NAME_LEN]; // 当前日志文件名
+    struct tm m_file_tm;            // 当前日志文件的日期
+    int m_part;                     // 当前文件是当天的第几个分文件
+    long long m_count;              // 当前文件已写入的行数
+    time_t m_next_day;              // 日志按天进行分类 下一天零点 (到达后切换文件)
+    int m_part_fd;                  // 预先打开的 下一个分文件，-1 表示没有
+    int m_day_fd;                   // 预先打开的 下一天的文件，-1 表示没有
+    char m_part_name[LOG_NAME_LEN]; // m_part_fd 的文件名
+    char m_day_name[LOG_NAME_LEN];  // m_day_fd 的文件名
+    std::vector<char> m_defined;    // 当前文件中 已写入定义的格式编号 (LOG_BINARY)
+
+    bool m_is_async;                     // 是否异步 标志位
+    int m_max_pending;                   // 最多积压的缓冲区数量
+    locker m_mutex;                      // 保护 以下成员
+    cond m_cond;                         // 有写满的缓冲区 / 需要立即写出 / 退出
+    cond m_space;                        // 写日志线程取走了积压的缓冲区 (LOG_BLOCK)
+    int m_waiters;                       // 等待 m_space 的线程数
+    int m_overflow;                      // 积压达到上限时的处理方式
+    int m_overflow_param;                // 处理方式的参数
+    std::vector<log_buffer *> m_full;    // 写满 等待写入文件的缓冲区
+    std::vector<log_buffer *> m_free;    // 空闲缓冲区
+    std::vector<log_thread *> m_threads; // 已注册的线程
+    std::vector<log_def> m_formats;      // 已注册的格式，下标为格式编号
+    bool m_force;                        // 立即收集未写满的缓冲区
+    bool m_stop;                         // 写日志线程退出
+    pthread_t m_tid;                     // 写日志线程
+
+    std::atomic<long long> m_dropped;    // 因积压丢弃的行数
+    std::atomic<long long> m_blocked;    // 因积压等待的次数
+    std::atomic<long long> m_blocked_ns; // 因积压等待的总时间
+    long long m_reported_dropped;        // 上次 report 时的 m_dropped
+    long long m_reported_blocked;        // 上次 report 时的 m_blocked
 };
 
 // __VA_ARGS__是一个可变参数的宏，定义时宏定义中参数列表的最后一个参数为省略号，在实际使用时会发现有时会加##，有时又不加。
 
-#define LOG_DEBUG(format, ...)                                   \
-    if (!Log::m_close_flag)                                      \
-    {                                                            \
-        Log::getInstance()->write_log(0, format, ##__VA_ARGS__); \
-    }
+// 每个调用点第一次执行时 注册格式 (局部静态变量)，之后只传递格式编号
 
-#define LOG_INFO(format, ...)                                    \
-    if (!Log::m_close_flag)                                      \
-    {                                                            \
-        Log::getInstance()->write_log(1, format, ##__VA_ARGS__); \
+#define LOG_RECORD(level, format, ...)                                                                \
+    if (!Log::m_close_flag)                                                                           \
+    {                                                                                                 \
+        static const int log_id =                                                                     \
+            Log::getInstance()->register_format(level, format, log_signature(format, ##__VA_ARGS__)); \
+        Log::getInstance()->write_record(level, log_id, format, ##__VA_ARGS__);                       \
     }
 
-#define LOG_WARN(format, ...)                                    \
-    if (!Log::m_close_flag)                                      \
-    {                                                            \
-        Log::getInstance()->write_log(2, format, ##__VA_ARGS__); \
-    }
+#define LOG_DEBUG(format, ...) LOG_RECORD(0, format, ##__VA_ARGS__)
 
-#define LOG_ERROR(format, ...)                                   \
-    if (!Log::m_close_flag)                                      \
-    {                                                            \
-        Log::getInstance()->write_log(3, format, ##__VA_ARGS__); \
-    }
+#define LOG_INFO(format, ...) LOG_RECORD(1, format, ##__VA_ARGS__)
+
+#define LOG_WARN(format, ...) LOG_RECORD(2, format, ##__VA_ARGS__)
+
+#define LOG_ERROR(format, ...) LOG_RECORD(3, format, ##__VA_ARGS__)
 
-#endif
\ No newline at end of file
+#endif
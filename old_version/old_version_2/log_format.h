@@ -0,0 +1,359 @@
+/*
+日志记录格式：
+
+    1. 日志模式：
+       LOG_TEXT     : 调用 LOG_* 的线程直接格式化为文本
+       LOG_DEFERRED : 调用线程只记录二进制日志记录，由写日志线程格式化为文本后写入文件
+       LOG_BINARY   : 二进制日志记录直接写入文件 (文件名加 .bin 后缀)，由 bin/log_decode 离线转换为文本
+    2. 每个 LOG_* 调用点第一次执行时 注册 (级别, 格式串, 参数类型签名)，得到格式编号；
+       之后每次调用 只写入 记录头 (格式编号, 记录长度, 纳秒时间戳) 与 参数的原始字节，不调用 vsnprintf / localtime
+    3. 参数类型签名每个参数一个字符：i 有符号整数、u 无符号整数、d 浮点数、p 指针 (均为 8 字节)，
+       s 字符串 (2 字节长度 + 内容，超过 LOG_STR_MAX 截断；空指针的长度为 LOG_STR_NULL、没有内容)
+    4. 二进制文件以 LOG_MAGIC 开头，写日志线程在每个文件中第一次出现某个格式编号之前，先写入该编号的定义记录
+       (编号带 LOG_DEF_FLAG，内容为 级别 + 签名 + 格式串)，因此每个文件可以单独解码
+    5. 文本格式化 (行前缀、按签名还原 printf 参数) 由 写日志线程 与 解码工具 共用
+    6. 行前缀的时间部分由 log_clock 缓存：秒数变化时才调用 localtime_r 重新格式化 "年-月-日 时:分:秒."，
+       同一秒内只填入 3 位毫秒
+*/
+
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <type_traits>
+
+// 日志模式
+enum LOG_MODE
+{
+    LOG_TEXT = 0, // 调用线程格式化
+    LOG_DEFERRED, // 写日志线程格式化
+    LOG_BINARY    // 写入二进制，离线解码
+};
+
+#define LOG_STR_MAX 1024              // 字符串参数 最多记录的字节数
+#define LOG_STR_NULL 0xffff           // 空指针字符串 记录的长度
+#define LOG_DEF_FLAG 0x80000000u      // 定义记录的编号标记
+#define LOG_DEF_MAX 65536             // 格式编号上限 (每个 LOG_* 调用点一个)，解码时超出视为损坏
+#define LOG_MAGIC "TWSLOG1\n"         // 二进制日志文件头
+#define LOG_MAGIC_SIZE 8
+
+// 记录头，之后紧跟 参数字节 (定义记录 为 级别 + 签名 + '\0' + 格式串 + '\0')。记录不对齐，按 memcpy 读写
+struct log_record
+{
+    uint32_t id;   // 格式编号
+    uint32_t size; // 记录总长度 (含记录头)
+    int64_t ns;    // 时间戳 (CLOCK_REALTIME 纳秒)
+};
+
+static const char *const log_levels[] = {"[debug]:", "[info]:", "[warn]:", "[erro]:"};
+
+inline const char *log_level_name(int level)
+{
+    return level >= 0 && level < 3 ? log_levels[level] : log_levels[3];
+}
+
+// 参数类型 对应的签名字符
+template <typename T>
+constexpr char log_type_of()
+{
+    using U = std::decay_t<T>;
+    if constexpr (std::is_same_v<U, const char *> || std::is_same_v<U, char *>)
+    {
+        return 's';
+    }
+    else if constexpr (std::is_floating_point_v<U>)
+    {
+        return 'd';
+    }
+    else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>)
+    {
+        return 'p';
+    }
+    else if constexpr (std::is_enum_v<U> || (std::is_integral_v<U> && std::is_signed_v<U>))
+    {
+        return 'i';
+    }
+    else
+    {
+        static_assert(std::is_integral_v<U>, "unsupported log argument type");
+        return 'u';
+    }
+}
+
+// 一个调用点的参数类型签名 (编译期生成)
+template <typename... Args>
+struct log_sig
+{
+    static constexpr char value[] = {log_type_of<Args>()..., '\0'};
+};
+
+template <typename... Args>
+inline const char *log_signature(const char *, const Args &...)
+{
+    return log_sig<std::decay_t<Args>...>::value;
+}
+
+// 参数 记录后的字节数
+template <typename T>
+inline uint32_t log_arg_size(T arg)
+{
+    if constexpr (log_type_of<T>() == 's')
+    {
+        size_t len = arg ? strnlen(arg, LOG_STR_MAX) : 0;
+        return (uint32_t)(2 + len); // 不超过 2 + LOG_STR_MAX
+    }
+    else
+    {
+        return 8;
+    }
+}
+
+// 写入参数的原始字节，返回写入后的位置
+template <typename T>
+inline char *log_arg_put(char *p, T arg)
+{
+    constexpr char type = log_type_of<T>();
+    if constexpr (type == 's')
+    {
+        if (arg == NULL)
+        {
+            uint16_t len = LOG_STR_NULL;
+            memcpy(p, &len, 2);
+            return p + 2;
+        }
+        uint16_t len = (uint16_t)strnlen(arg, LOG_STR_MAX); // 不超过 LOG_STR_MAX
+        memcpy(p, &len, 2);
+        memcpy(p + 2, arg, len);
+        return p + 2 + len;
+    }
+    else if constexpr (type == 'd')
+    {
+        double v = arg;
+        memcpy(p, &v, 8);
+    }
+    else if constexpr (type == 'p')
+    {
+        uint64_t v = (uint64_t)(uintptr_t)arg;
+        memcpy(p, &v, 8);
+    }
+    else if constexpr (type == 'i')
+    {
+        int64_t v = (int64_t)arg;
+        memcpy(p, &v, 8);
+    }
+    else
+    {
+        uint64_t v = (uint64_t)arg;
+        memcpy(p, &v, 8);
+    }
+    return p + 8;
+}
+
+// 时间戳前缀缓存 (每个使用者一份，不加锁)
+struct log_clock
+{
+    time_t sec;    // 缓存的秒数
+    struct tm tm;  // sec 对应的本地时间
+    char text[32]; // "年-月-日 时:分:秒."
+    int len;       // text 的长度
+
+    log_clock() : sec(-1), len(0) {}
+
+    // 更新到 now 所在的秒：秒数不变时 直接返回
+    void update(time_t now)
+    {
+        if (now == sec)
+        {
+            return;
+        }
+        sec = now;
+        localtime_r(&now, &tm);
+        len = snprintf(text, sizeof(text), "%d-%02d-%02d %02d:%02d:%02d.", tm.tm_year + 1900, tm.tm_mon + 1,
+                       tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    }
+
+    // 行前缀：年-月-日 时:分:秒.毫秒 [级别]:  最多 48 字节，返回长度。调用前先 update
+    int prefix(char *buf, int ms, int level)
+    {
+        memcpy(buf, text, len);
+        char *p = buf + len;
+        p[0] = (char)('0' + ms / 100);
+        p[1] = (char)('0' + ms / 10 % 10);
+        p[2] = (char)('0' + ms % 10);
+        p[3] = ' ';
+        const char *name = log_level_name(level);
+        size_t name_len = strlen(name);
+        memcpy(p + 4, name, name_len);
+        return len + 4 + (int)name_len;
+    }
+};
+
+// 按签名读取参数字节，还原 printf 格式串。最多写入 size - 1 字节 (以 '\0' 结尾)，返回写入的长度。
+// 每个转换说明去掉长度修饰后 按签名的类型重新调用 snprintf；参数不足 或 记录损坏时 停止
+inline int log_format_args(char *out, int size, const char *fmt, const char *sig, const char *args, int len)
+{
+    int n = 0;
+    const char *end = args + len;
+    char spec[32];
+    char str[LOG_STR_MAX + 1];
+    while (*fmt && n < size - 1)
+    {
+        if (*fmt != '%')
+        {
+            out[n++] = *fmt++;
+            continue;
+        }
+        if (fmt[1] == '%')
+        {
+            out[n++] = '%';
+            fmt += 2;
+            continue;
+        }
+
+        // 标志、宽度、精度 原样保留 (不支持 *)，跳过长度修饰
+        int k = 0;
+        spec[k++] = *fmt++;
+        while (*fmt && strchr("-+ #0123456789.", *fmt) && k < 24)
+        {
+            spec[k++] = *fmt++;
+        }
+        while (*fmt && strchr("hlqjztL", *fmt))
+        {
+            ++fmt;
+        }
+        char conv = *fmt;
+        if (conv == '\0')
+        {
+            break;
+        }
+        ++fmt;
+
+        // 取出下一个参数
+        char type = *sig;
+        if (type == '\0')
+        {
+            break;
+        }
+        ++sig;
+        int64_t iv = 0;
+        double dv = 0;
+        if (type == 's')
+        {
+            uint16_t slen;
+            if (end - args < 2)
+            {
+                break;
+            }
+            memcpy(&slen, args, 2);
+            args += 2;
+            if (slen == LOG_STR_NULL)
+            {
+                strcpy(str, "(null)"); // 与 glibc printf 相同
+            }
+            else if (slen > LOG_STR_MAX || end - args < slen)
+            {
+                break;
+            }
+            else
+            {
+                memcpy(str, args, slen);
+                str[slen] = '\0';
+                args += slen;
+            }
+        }
+        else
+        {
+            if (end - args < 8)
+            {
+                break;
+            }
+            if (type == 'd')
+            {
+                memcpy(&dv, args, 8);
+                iv = (int64_t)dv;
+            }
+            else
+            {
+                memcpy(&iv, args, 8);
+                dv = (double)iv;
+            }
+            args += 8;
+        }
+
+        int m = 0;
+        int room = size - n;
+        switch (conv)
+        {
+        case 'd':
+        case 'i':
+            spec[k++] = 'l';
+            spec[k++] = 'l';
+            spec[k++] = conv;
+            spec[k] = '\0';
+            m = snprintf(out + n, room, spec, (long long)iv);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            spec[k++] = 'l';
+            spec[k++] = 'l';
+            spec[k++] = conv;
+            spec[k] = '\0';
+            m = snprintf(out + n, room, spec, (unsigned long long)iv);
+            break;
+        case 'c':
+            spec[k++] = conv;
+            spec[k] = '\0';
+            m = snprintf(out + n, room, spec, (int)iv);
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec[k++] = conv;
+            spec[k] = '\0';
+            m = snprintf(out + n, room, spec, dv);
+            break;
+        case 's':
+            spec[k++] = conv;
+            spec[k] = '\0';
+            m = snprintf(out + n, room, spec, type == 's' ? str : "(?)");
+            break;
+        case 'p':
+            spec[k++] = conv;
+            spec[k] = '\0';
+            m = snprintf(out + n, room, spec, (void *)(uintptr_t)iv);
+            break;
+        default:
+            break; // 不支持的转换 (如 %n)，丢弃该参数
+        }
+        if (m < 0)
+        {
+            m = 0;
+        }
+        n += m < room ? m : room - 1;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+// 格式化一条数据记录为一行文本 (含换行)。level/fmt/sig 来自记录的定义，最多写入 size 字节，返回长度
+inline int log_format_record(char *out, int size, log_clock &clock, const log_record &r, const char *payload,
+                             int level, const char *fmt, const char *sig)
+{
+    clock.update(r.ns / 1000000000);
+    int n = clock.prefix(out, (int)(r.ns % 1000000000 / 1000000), level);
+    n += log_format_args(out + n, size - n - 1, fmt, sig, payload, (int)(r.size - sizeof(log_record)));
+    out[n++] = '\n';
+    return n;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "overload.h"
+#include "log.h"
+
+// 503 响应体
+static const char *busy_503_form = "The server is overloaded, please retry later.\n";
+
+// 预先生成 503 响应
+overload::overload() : m_first_above(0), m_dropping(false), m_drop_next(0), m_drop_count(0), m_reported(0)
+{
+    m_busy_len = snprintf(m_busy_response, sizeof(m_busy_response),
+                          "HTTP/1.1 503 Service Unavailable\r\n"
+                          "Retry-After: %d\r\n"
+                          "Content-Length: %d\r\n"
+                          "Content-Type:text/html\r\n"
+                          "Connection: close\r\n"
+                          "\r\n%s",
+                          RETRY_AFTER_SECONDS, (int)strlen(busy_503_form), busy_503_form);
+    for (int i = 0; i < SHED_REASON_SIZE; ++i)
+    {
+        m_shed[i] = 0;
+    }
+}
+
+// 工作线程取到任务时调用，上报 排队时延
+void overload::on_dequeue(time_t sojourn, time_t now)
+{
+    if (sojourn < CODEL_TARGET_MS)
+    {
+        // 排队时延回落，退出丢弃状态
+        m_first_above.store(0, std::memory_order_relaxed);
+        if (m_dropping.load(std::memory_order_relaxed))
+        {
+            m_dropping.store(false, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    time_t first_above = m_first_above.load(std::memory_order_relaxed);
+    if (first_above == 0)
+    {
+        // 首次超过目标值，开始计时
+        m_first_above.compare_exchange_strong(first_above, now + CODEL_INTERVAL_MS, std::memory_order_relaxed);
+    }
+    else if (now >= first_above && !m_dropping.load(std::memory_order_relaxed))
+    {
+        // 持续一个 interval 都超过目标值，进入丢弃状态
+        m_drop_count.store(0, std::memory_order_relaxed);
+        m_drop_next.store(now, std::memory_order_relaxed);
+        m_dropping.store(true, std::memory_order_relaxed);
+        LOG_WARN("queue delay %ldms above target for %dms, start shedding.", sojourn, CODEL_INTERVAL_MS);
+    }
+}
+
+// 事件循环将请求加入线程池之前调用，返回假表示应当拒绝该请求
+bool overload::admit(time_t now)
+{
+    if (!m_dropping.load(std::memory_order_relaxed))
+    {
+        return true;
+    }
+
+    // CoDel 控制律：拒绝间隔随 拒绝次数 按 1/sqrt(count) 缩短
+    time_t drop_next = m_drop_next.load(std::memory_order_relaxed);
+    if (now < drop_next)
+    {
+        return true;
+    }
+    int count = m_drop_count.fetch_add(1, std::memory_order_relaxed) + 1;
+    time_t next = now + (time_t)(CODEL_INTERVAL_MS / sqrt((double)count));
+    // 多个事件循环同时到达时只有一个拒绝，其余放行
+    return !m_drop_next.compare_exchange_strong(drop_next, next, std::memory_order_relaxed);
+}
+
+// 向 sockfd 直接发送 预先生成的 503 响应，并记录拒绝原因
+void overload::reject(int sockfd, SHED_REASON reason)
+{
+    // 响应很短，一次性写入 socket 发送缓冲区，写不进去也不等待
+    send(sockfd, m_busy_response, m_busy_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    m_shed[reason].fetch_add(1, std::memory_order_relaxed);
+}
+
+// 被拒绝的请求数量
+long long overload::shed_count(SHED_REASON reason) const
+{
+    return m_shed[reason].load(std::memory_order_relaxed);
+}
+
+// 是否处于丢弃状态
+bool overload::dropping() const
+{
+    return m_dropping.load(std::memory_order_relaxed);
+}
+
+// 统计有变化时 写入日志
+void overload::report()
+{
+    long long queue_full = shed_count(SHED_QUEUE_FULL);
+    long long codel = shed_count(SHED_CODEL);
+    long long conn_limit = shed_count(SHED_CONN_LIMIT);
+    long long total = queue_full + codel + conn_limit;
+    if (total == m_reported)
+    {
+        return;
+    }
+    m_reported = total;
+    LOG_WARN("shed requests: queue_full=%lld, codel=%lld, conn_limit=%lld.", queue_full, codel, conn_limit);
+}
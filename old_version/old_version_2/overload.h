@@ -0,0 +1,74 @@
+/*
+过载控制类：
+
+    采用 单例模式 (懒汉模式)，所有事件循环与工作线程共享
+    1. 预先生成 503 Service Unavailable (带 Retry-After) 响应，过载时由事件循环直接发送，不进入线程池
+    2. 参考 CoDel：工作线程取到任务时上报 排队时延，排队时延持续 CODEL_INTERVAL_MS 超过 CODEL_TARGET_MS
+       则进入丢弃状态，按 CoDel 控制律 (间隔 interval / sqrt(count)) 拒绝新请求，直到排队时延回落
+    3. 统计 被拒绝的请求数量，并定期写入日志
+*/
+
+#ifndef OVERLOAD_H
+#define OVERLOAD_H
+
+#include <time.h>
+#include <atomic>
+
+#define CODEL_TARGET_MS 5      // 可接受的排队时延 (毫秒)
+#define CODEL_INTERVAL_MS 100  // 排队时延超过目标值 持续多久 进入丢弃状态 (毫秒)
+#define RETRY_AFTER_SECONDS 1  // 503 响应中 Retry-After 的秒数
+
+// 被拒绝的原因
+enum SHED_REASON
+{
+    SHED_QUEUE_FULL = 0, // 线程池请求队列已满
+    SHED_CODEL,          // 排队时延过高
+    SHED_CONN_LIMIT,     // 连接数量达到上限
+    SHED_REASON_SIZE
+};
+
+class overload
+{
+public:
+    // C++11 之后，使用局部静态变量 懒汉模式 无需加锁处理
+    static overload *getInstance()
+    {
+        static overload instance;
+        return &instance;
+    }
+
+    // 工作线程取到任务时调用，上报 排队时延。now 为当前时间 (毫秒)
+    void on_dequeue(time_t sojourn, time_t now);
+
+    // 事件循环将请求加入线程池之前调用，返回假表示应当拒绝该请求
+    bool admit(time_t now);
+
+    // 向 sockfd 直接发送 预先生成的 503 响应，并记录拒绝原因。不关闭连接
+    void reject(int sockfd, SHED_REASON reason);
+
+    // 被拒绝的请求数量
+    long long shed_count(SHED_REASON reason) const;
+
+    // 是否处于丢弃状态 (排队时延持续超过目标值)
+    bool dropping() const;
+
+    // 统计有变化时 写入日志
+    void report();
+
+private:
+    overload();
+
+private:
+    char m_busy_response[256]; // 预先生成的 503 响应
+    int m_busy_len;            // 503 响应长度
+
+    std::atomic<time_t> m_first_above; // 排队时延首次超过目标值后 + interval 的时间，0 表示未超过
+    std::atomic<bool> m_dropping;      // 是否处于丢弃状态
+    std::atomic<time_t> m_drop_next;   // 丢弃状态下 下一次拒绝的时间
+    std::atomic<int> m_drop_count;     // 本次丢弃状态中 已拒绝的数量
+
+    std::atomic<long long> m_shed[SHED_REASON_SIZE]; // 各原因 被拒绝的请求数量
+    long long m_reported;                            // 上次写入日志时的 总拒绝数量
+};
+
+#endif
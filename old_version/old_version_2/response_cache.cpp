@@ -0,0 +1,350 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "response_cache.h"
+#include "log.h"
+
+response_cache::response_cache() : m_max_bytes(RESPONSE_CACHE_BYTES / RESPONSE_CACHE_SHARDS),
+                                   m_max_file(RESPONSE_CACHE_MAX_FILE), m_ttl_ms(FILE_CACHE_TTL_MS),
+                                   m_hits(0), m_misses(0), m_admits(0), m_rejects(0), m_reported(0)
+{
+    for (int i = 0; i < RESPONSE_CACHE_SHARDS; ++i)
+    {
+        m_shards[i].bytes = 0;
+        m_shards[i].generation = 0;
+        m_shards[i].samples = 0;
+        memset(m_shards[i].sketch, 0, sizeof(m_shards[i].sketch));
+    }
+}
+
+// 释放缓存持有的引用
+response_cache::~response_cache()
+{
+    for (int i = 0; i < RESPONSE_CACHE_SHARDS; ++i)
+    {
+        for (cached_response *e : m_shards[i].lru)
+        {
+            release(e);
+        }
+    }
+}
+
+// 设置缓存限制。在工作线程启动之前调用
+void response_cache::init(long long max_bytes, int max_file, int ttl_ms)
+{
+    m_max_bytes = (max_bytes + RESPONSE_CACHE_SHARDS - 1) / RESPONSE_CACHE_SHARDS;
+    m_max_file = max_file;
+    m_ttl_ms = ttl_ms;
+}
+
+// 单调时钟 (毫秒)
+time_t response_cache::now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 按路径哈希选择分片。分片用哈希的高位，Sketch 用低位
+response_cache::shard &response_cache::get_shard(size_t hash)
+{
+    return m_shards[(hash >> 48) % RESPONSE_CACHE_SHARDS];
+}
+
+// 第 i 行的计数器下标
+static inline int sketch_index(size_t hash, int i)
+{
+    uint64_t h = (uint64_t)hash * (0x9E3779B97F4A7C15ULL + 2 * i);
+    return (h >> 32) & (SKETCH_WIDTH - 1);
+}
+
+// 记录一次访问。每 SKETCH_SAMPLE 次访问 所有计数器减半，使频率估计只反映近期访问
+void response_cache::sketch_add(shard &s, size_t hash)
+{
+    for (int i = 0; i < SKETCH_DEPTH; ++i)
+    {
+        uint8_t &c = s.sketch[i][sketch_index(hash, i)];
+        if (c < SKETCH_MAX)
+        {
+            ++c;
+        }
+    }
+    if (++s.samples >= SKETCH_SAMPLE)
+    {
+        for (int i = 0; i < SKETCH_DEPTH; ++i)
+        {
+            for (int j = 0; j < SKETCH_WIDTH; ++j)
+            {
+                s.sketch[i][j] >>= 1;
+            }
+        }
+        s.samples = 0;
+    }
+}
+
+// 估计访问频率：各行计数器的最小值
+int response_cache::sketch_estimate(const shard &s, size_t hash)
+{
+    int freq = SKETCH_MAX;
+    for (int i = 0; i < SKETCH_DEPTH; ++i)
+    {
+        int c = s.sketch[i][sketch_index(hash, i)];
+        freq = c < freq ? c : freq;
+    }
+    return freq;
+}
+
+// 记录访问并查找。过期的条目直接移除，由本次请求重新准入
+cached_response *response_cache::acquire(const char *path)
+{
+    if (m_max_bytes <= 0)
+    {
+        return NULL;
+    }
+    std::string_view key(path);
+    size_t hash = std::hash<std::string_view>()(key);
+    shard &s = get_shard(hash);
+    time_t now = now_ms();
+    cached_response *e = NULL;
+    cached_response *expired = NULL;
+
+    s.lock.lock();
+    sketch_add(s, hash);
+    auto it = s.map.find(key);
+    if (it != s.map.end())
+    {
+        e = *it->second;
+        if (now < e->expire.load(std::memory_order_relaxed))
+        {
+            s.lru.splice(s.lru.begin(), s.lru, it->second); // 移到 LRU 表头
+            e->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            erase(s, it->second);
+            expired = e;
+            e = NULL;
+        }
+    }
+    s.lock.unlock();
+
+    if (expired != NULL)
+    {
+        release(expired);
+    }
+    if (e != NULL)
+    {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    return e;
+}
+
+// 为放入 need 字节 从 LRU 表尾开始淘汰。只有新条目的频率高于淘汰对象时才允许淘汰
+bool response_cache::make_room(shard &s, long long need, int freq, std::list<cached_response *> *victims)
+{
+    long long bytes = s.bytes;
+    auto it = s.lru.end();
+    while (bytes + need > m_max_bytes)
+    {
+        if (it == s.lru.begin())
+        {
+            return false; // 整个分片都放不下
+        }
+        --it;
+        cached_response *victim = *it;
+        if (sketch_estimate(s, std::hash<std::string_view>()(victim->path)) >= freq)
+        {
+            return false; // 淘汰对象更热，拒绝准入
+        }
+        bytes -= victim->len;
+    }
+    if (victims != NULL)
+    {
+        while (s.bytes + need > m_max_bytes)
+        {
+            victims->push_back(s.lru.back());
+            erase(s, std::prev(s.lru.end()));
+        }
+    }
+    return true;
+}
+
+static const char keep_alive[] = "Connection: keep-alive\r\n\r\n";
+
+// 创建完整响应，引用计数为 1
+cached_response *response_cache::create(const file_entry *file, const char *header, int header_len, size_t body_len)
+{
+    cached_response *e = new cached_response;
+    e->path = file->path;
+    e->st = file->st;
+    e->head_len = header_len + sizeof(keep_alive) - 1;
+    e->len = e->head_len + body_len;
+    memcpy(e->etag, file->etag, sizeof(e->etag));
+    memcpy(e->last_modified, file->last_modified, sizeof(e->last_modified));
+    e->encodings = file->encodings;
+    e->compressible = file->compressible;
+    e->data = new char[e->len];
+    memcpy(e->data, header, header_len);
+    memcpy(e->data + header_len, keep_alive, sizeof(keep_alive) - 1);
+    e->close_head_len = snprintf(e->close_head, sizeof(e->close_head), "%.*sConnection: close\r\n\r\n",
+                                 header_len, header);
+    e->expire.store(0, std::memory_order_relaxed);
+    e->refs.store(1, std::memory_order_relaxed);
+    if (e->close_head_len >= (int)sizeof(e->close_head))
+    {
+        release(e);
+        return NULL;
+    }
+    return e;
+}
+
+// 按 TinyLFU 判断是否准入。先在锁内判断，再在锁外读取文件，最后重新判断后插入。
+// 读取期间分片发生过失效 (文件被修改) 时放弃插入，避免缓存旧的或不完整的内容
+void response_cache::admit(file_entry *file)
+{
+    // 预压缩变体的路径是 .gz 等兄弟文件本身，不能以此为键缓存带 Content-Encoding 的响应
+    if (m_max_bytes <= 0 || file->st.st_size > m_max_file || file->encoding >= 0)
+    {
+        return;
+    }
+    std::string_view key(file->path);
+    size_t hash = std::hash<std::string_view>()(key);
+    shard &s = get_shard(hash);
+    long long need = file->header_len + sizeof(keep_alive) - 1 + file->st.st_size;
+
+    s.lock.lock();
+    bool ok = s.map.find(key) == s.map.end() && make_room(s, need, sketch_estimate(s, hash), NULL);
+    unsigned generation = s.generation;
+    s.lock.unlock();
+    if (!ok)
+    {
+        m_rejects.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // 记下失效代数之前 文件可能已被修改，此时的失效不会反映在代数上，需重新校验
+    if (!file_cache::unchanged(file->path.c_str(), file))
+    {
+        return;
+    }
+
+    // 生成完整响应。文件内容从映射中拷贝，没有映射则 pread
+    cached_response *e = create(file, file->header, file->header_len, file->st.st_size);
+    if (e == NULL)
+    {
+        return;
+    }
+    if (!file_cache::read(file, e->data + e->head_len))
+    {
+        release(e); // 文件在读取过程中被截断
+        return;
+    }
+    e->expire.store(now_ms() + m_ttl_ms, std::memory_order_relaxed);
+
+    std::list<cached_response *> victims;
+    s.lock.lock();
+    ok = s.generation == generation && s.map.find(key) == s.map.end() &&
+         make_room(s, need, sketch_estimate(s, hash), &victims);
+    if (ok)
+    {
+        s.lru.push_front(e);
+        s.map[e->path] = s.lru.begin();
+        s.bytes += need;
+    }
+    s.lock.unlock();
+
+    for (cached_response *v : victims)
+    {
+        release(v);
+    }
+    if (!ok)
+    {
+        release(e);
+        m_rejects.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_admits.fetch_add(1, std::memory_order_relaxed);
+}
+
+// 从分片中移除条目，不释放缓存持有的引用 (需持有分片锁)
+void response_cache::erase(shard &s, std::list<cached_response *>::iterator it)
+{
+    cached_response *e = *it;
+    s.map.erase(std::string_view(e->path));
+    s.bytes -= e->len;
+    s.lru.erase(it);
+}
+
+// 使 path 对应的条目失效。正在发送的响应仍持有引用，发送完毕后才真正释放
+void response_cache::invalidate(const char *path)
+{
+    std::string_view key(path);
+    size_t hash = std::hash<std::string_view>()(key);
+    shard &s = get_shard(hash);
+    cached_response *e = NULL;
+
+    s.lock.lock();
+    ++s.generation;
+    auto it = s.map.find(key);
+    if (it != s.map.end())
+    {
+        e = *it->second;
+        erase(s, it->second);
+    }
+    s.lock.unlock();
+
+    if (e != NULL)
+    {
+        release(e);
+    }
+}
+
+// 使所有条目失效。各分片的条目在锁内整体摘下，在锁外释放
+void response_cache::clear()
+{
+    for (int i = 0; i < RESPONSE_CACHE_SHARDS; ++i)
+    {
+        shard &s = m_shards[i];
+        std::list<cached_response *> victims;
+        s.lock.lock();
+        victims.swap(s.lru);
+        s.map.clear();
+        s.bytes = 0;
+        ++s.generation;
+        s.lock.unlock();
+
+        for (cached_response *e : victims)
+        {
+            release(e);
+        }
+    }
+}
+
+// 释放一个引用，最后一个引用释放时 释放内存
+void response_cache::release(cached_response *entry)
+{
+    if (entry->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    delete[] entry->data;
+    delete entry;
+}
+
+// 统计有变化时 写入日志
+void response_cache::report()
+{
+    long long hits = m_hits.load(std::memory_order_relaxed);
+    long long misses = m_misses.load(std::memory_order_relaxed);
+    if (hits + misses == m_reported)
+    {
+        return;
+    }
+    m_reported = hits + misses;
+    LOG_INFO("response cache: hits=%lld, misses=%lld, admits=%lld, rejects=%lld.", hits, misses,
+             m_admits.load(std::memory_order_relaxed), m_rejects.load(std::memory_order_relaxed));
+}
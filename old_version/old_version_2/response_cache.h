@@ -0,0 +1,133 @@
+/*
+完整响应缓存类：
+
+    采用 单例模式 (懒汉模式)，所有工作线程共享
+    1. 对小文件 (不超过 RESPONSE_CACHE_MAX_FILE) 缓存 不可变的完整响应：响应首行 + 头部 + 响应体，
+       命中时直接把该内存块交给 writev，不再生成头部、不再访问文件
+    2. 保持连接的请求 发送一整块；不保持连接的请求 发送 预先生成的 Connection: close 头部 + 响应体 两块
+    3. 准入策略为 TinyLFU：每个分片用 Count-Min Sketch 记录近期访问频率 (定期减半衰减)，
+       缓存已满时 只有新文件的频率高于 LRU 表尾的淘汰对象 才准入，避免一次性访问的文件冲掉热点文件
+    4. 按内存预算限制缓存大小；条目通过引用计数管理，超过 TTL 后失效，由下一次请求重新准入
+*/
+
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "file_cache.h"
+#include "locker.h"
+
+#define RESPONSE_CACHE_SHARDS 16              // 分片数量
+#define RESPONSE_CACHE_BYTES (64LL << 20)     // 默认 内存预算
+#define RESPONSE_CACHE_MAX_FILE (32 << 10)    // 默认 可缓存的最大文件
+#define SKETCH_WIDTH 1024                     // 每个分片 Count-Min Sketch 每行的计数器数量 (2 的幂)
+#define SKETCH_DEPTH 4                        // Count-Min Sketch 行数
+#define SKETCH_MAX 15                         // 计数器上限
+#define SKETCH_SAMPLE (10 * SKETCH_WIDTH)     // 每记录多少次访问 所有计数器减半
+
+// 一个缓存的完整响应。创建后只读，由引用计数管理
+struct cached_response
+{
+    std::string path;                    // 文件完整路径 (缓存的键)
+    struct stat st;                      // 生成响应时的文件状态
+    char *data;                          // 完整响应：Connection: keep-alive 头部 + 响应体
+    size_t len;                          // 完整响应长度
+    size_t head_len;                     // 其中头部的长度
+    char close_head[FILE_HEADER_SIZE];   // Connection: close 的头部
+    int close_head_len;                  // Connection: close 头部长度
+    char etag[ETAG_SIZE];                // 实体标签，用于条件请求
+    char last_modified[HTTP_DATE_SIZE];  // 修改时间 (HTTP 日期)
+    unsigned encodings;                  // 文件存在的预压缩变体，客户端接受其一时 不使用本缓存
+    bool compressible;                   // 文件是否为可压缩的文本类型
+    std::atomic<time_t> expire;          // 过期时间
+    std::atomic<int> refs;               // 引用计数
+};
+
+class response_cache
+{
+public:
+    // C++11 之后，使用局部静态变量 懒汉模式 无需加锁处理
+    static response_cache *getInstance()
+    {
+        static response_cache instance;
+        return &instance;
+    }
+
+    // 设置 内存预算、可缓存的最大文件、过期时间。max_bytes 为 0 表示不缓存
+    void init(long long max_bytes, int max_file, int ttl_ms);
+
+    // 记录一次访问。命中且未过期 返回已加一引用的条目 (用完需 release)，否则返回 NULL
+    cached_response *acquire(const char *path);
+
+    // 未命中后 已经打开了文件，按 TinyLFU 判断是否准入，准入则读取文件生成完整响应。只缓存未压缩的响应
+    void admit(file_entry *file);
+
+    // 释放一个引用，最后一个引用释放时 释放内存
+    static void release(cached_response *entry);
+
+    // 创建完整响应 (引用计数为 1)：header + Connection: keep-alive + 空行，其后 body_len 字节的响应体由调用者填充，
+    // 同时生成 Connection: close 的头部。头部过长返回 NULL
+    static cached_response *create(const file_entry *file, const char *header, int header_len, size_t body_len);
+
+    // 使 path 对应的条目失效
+    void invalidate(const char *path);
+
+    // 使所有条目失效
+    void clear();
+
+    // 统计有变化时 写入日志
+    void report();
+
+private:
+    response_cache();
+    ~response_cache();
+
+    // 分片：互斥锁 + 哈希表 + LRU 链表 (表头为最近使用) + 访问频率估计
+    struct shard
+    {
+        locker lock;
+        std::unordered_map<std::string_view, std::list<cached_response *>::iterator> map;
+        std::list<cached_response *> lru;
+        long long bytes;                             // 本分片缓存的总字节数
+        uint8_t sketch[SKETCH_DEPTH][SKETCH_WIDTH];  // Count-Min Sketch
+        int samples;                                 // 上次衰减以来 记录的访问次数
+        unsigned generation;                         // 失效代数：invalidate / clear 时递增
+    };
+
+    shard &get_shard(size_t hash);
+    static time_t now_ms();
+
+    // Count-Min Sketch：记录一次访问 / 估计访问频率 (需持有分片锁)
+    static void sketch_add(shard &s, size_t hash);
+    static int sketch_estimate(const shard &s, size_t hash);
+
+    // 为放入 need 字节 按 TinyLFU 淘汰 LRU 表尾条目。频率不高于表尾条目时返回假 (需持有分片锁)
+    // victims 非 NULL 时真正淘汰，被淘汰的条目放入 victims，由调用者在锁外释放
+    bool make_room(shard &s, long long need, int freq, std::list<cached_response *> *victims);
+
+    // 从分片中移除条目，不释放缓存持有的引用 (需持有分片锁)
+    void erase(shard &s, std::list<cached_response *>::iterator it);
+
+private:
+    shard m_shards[RESPONSE_CACHE_SHARDS]; // 分片
+    long long m_max_bytes;                 // 每个分片的内存预算
+    int m_max_file;                        // 可缓存的最大文件
+    int m_ttl_ms;                          // 条目有效时间
+
+    std::atomic<long long> m_hits;     // 命中次数
+    std::atomic<long long> m_misses;   // 未命中次数
+    std::atomic<long long> m_admits;   // 准入次数
+    std::atomic<long long> m_rejects;  // 被 TinyLFU 拒绝的次数
+    long long m_reported;              // 上次写入日志时的 总查询次数
+};
+
+#endif
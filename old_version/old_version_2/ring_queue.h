@@ -0,0 +1,150 @@
+/*
+无锁有界 多生产者多消费者 环形队列 (Vyukov MPMC)：
+
+    每个槽带有一个序号 sequence，生产者/消费者通过 CAS 抢占 入队/出队 位置，
+    再根据槽序号判断该槽是否可写/可读，全程不加锁。
+    入队/出队光标以及槽数组 按缓存行对齐，避免生产者与消费者之间的伪共享。
+    槽数组的大小向上取整为 2 的幂；元素数量仍限制在构造时给定的容量之内 (如 10000 而不是 16384)。
+*/
+
+#ifndef RING_QUEUE_H
+#define RING_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <exception>
+
+#define CACHE_LINE_SIZE 64 // 缓存行大小
+
+template <typename T>
+class ring_queue
+{
+public:
+    ring_queue(size_t capacity)
+    {
+        if (capacity == 0)
+        {
+            throw std::exception();
+        }
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_limit = capacity;
+        m_cells = new cell[size];
+        for (size_t i = 0; i < size; ++i)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_enqueue_pos.store(0, std::memory_order_relaxed);
+        m_dequeue_pos.store(0, std::memory_order_relaxed);
+    }
+
+    ~ring_queue()
+    {
+        delete[] m_cells;
+    }
+
+    // 入队，队列满返回 false
+    bool push(const T &value)
+    {
+        cell *c;
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            c = m_cells + (pos & m_mask);
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                // 容量不是 2 的幂时 另外检查元素数量。读到的出队光标只会偏小，抢占成功时 数量不超过 m_limit
+                if (m_limit <= m_mask && pos - m_dequeue_pos.load(std::memory_order_relaxed) >= m_limit)
+                {
+                    return false;
+                }
+                // 槽可写，抢占入队位置
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // 槽仍未被消费，队列满
+            }
+            else
+            {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed); // 被其他生产者抢先，重新读取
+            }
+        }
+        c->data = value;
+        c->sequence.store(pos + 1, std::memory_order_release); // 通知消费者 槽可读
+        return true;
+    }
+
+    // 出队，队列空返回 false
+    bool pop(T &value)
+    {
+        cell *c;
+        size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            c = m_cells + (pos & m_mask);
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                // 槽可读，抢占出队位置
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // 槽尚未写入，队列空
+            }
+            else
+            {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed); // 被其他消费者抢先，重新读取
+            }
+        }
+        value = c->data;
+        c->sequence.store(pos + m_mask + 1, std::memory_order_release); // 通知生产者 下一圈可写
+        return true;
+    }
+
+    // 队列容量 (构造时给定)
+    size_t capacity() const
+    {
+        return m_limit;
+    }
+
+    // 当前元素数量 (近似值，仅用于统计)
+    size_t size() const
+    {
+        size_t enq = m_enqueue_pos.load(std::memory_order_relaxed);
+        size_t deq = m_dequeue_pos.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+private:
+    // 队列槽，按缓存行对齐
+    struct alignas(CACHE_LINE_SIZE) cell
+    {
+        std::atomic<size_t> sequence; // 槽序号
+        T data;                       // 数据
+    };
+
+    alignas(CACHE_LINE_SIZE) cell *m_cells;                     // 槽数组
+    size_t m_mask;                                              // 槽数组大小 - 1
+    size_t m_limit;                                             // 容量：最多保存的元素数量
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_enqueue_pos; // 入队光标
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_dequeue_pos; // 出队光标
+    char m_pad[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];  // 填充，避免与后续对象共享缓存行
+};
+
+#endif
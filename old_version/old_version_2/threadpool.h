@@ -2,10 +2,22 @@
 #define THREADPOOL_H
 
 #include <pthread.h>
-#include <list>
 #include <exception>
 #include <cstdio>
-#include "locker.h" // 自己的类 导入
+#include "locker.h"     // 自己的类 导入
+#include "ring_queue.h" // 无锁环形队列
+
+#define SPIN_COUNT 200 // 空闲线程 休眠前 自旋尝试取任务的次数
+
+// 线程池调度模式
+// 工作窃取模式的本地队列 直接使用 MPMC 环形队列 ring_queue (先进先出，本线程与窃取者都从队头取)，
+// 而不是 Chase-Lev 双端队列 (本线程后进先出、窃取者先进先出)：任务是整条连接的请求，
+// 按到达顺序处理即可，且 ring_queue 已允许 事件循环线程入队、多个线程出队。这是有意的简化
+enum POOL_MODE
+{
+    POOL_SHARED = 0, // 所有线程共享一个请求队列
+    POOL_STEALING    // 每个线程拥有本地队列，按连接哈希/轮询分发，空闲线程从其他线程窃取任务
+};
 
 // template <typename T>
 // class threadpool;
@@ -15,32 +27,54 @@ template <typename T>
 class threadpool
 {
 private:
-    int m_thread_size;          // 线程的数量
-    pthread_t *m_threads;       // 线程池 数组，大小为线程数量
-    int m_max_requests;         // 请求队列中最多允许的，等待处理的请求数量
-    std::list<T *> m_workqueue; // 请求队列 (所有线程共享)  所有线程都属于 线程池 类对象
-    locker m_queuelocker;       // 互斥锁
-    sem m_queuestat;            // 信号量： 用于判断是否有任务需要处理
-    bool m_stop;                // 是否结束线程
+    int m_thread_size;            // 线程的数量
+    pthread_t *m_threads;         // 线程池 数组，大小为线程数量
+    int m_max_requests;           // 请求队列中最多允许的，等待处理的请求数量
+    int m_mode;                   // 调度模式 POOL_MODE
+    ring_queue<T *> m_workqueue;  // 请求队列 (所有线程共享，无锁)  所有线程都属于 线程池 类对象
+    event_count m_queuestat;      // 事件计数器： 空闲线程自旋之后在此休眠，有任务时被唤醒
+    std::atomic<bool> m_stop;     // 是否结束线程
+
+    // 工作窃取模式
+    ring_queue<T *> **m_local;    // 每个线程的本地请求队列
+    event_count *m_localstat;     // 每个线程的事件计数器，线程空闲时休眠在自己的计数器上
+    std::atomic<bool> *m_parked;  // 每个线程 是否正在休眠
+    std::atomic<int> m_nparked;   // 正在休眠的线程数量
+    std::atomic<unsigned> m_rr;   // 无连接哈希时 轮询分发的计数
+    std::atomic<int> m_worker_id; // 为工作线程分配编号
 
 private:
-    static void *worker(void *arg); // 工作函数 (调用run()),它不断从工作队列中取出任务并执行之
-    void run();                     // 线程池 实际工作函数，调用http::conn对象函数处理
+    static void *worker(void *arg);       // 工作函数 (调用run()),它不断从工作队列中取出任务并执行之
+    void run();                           // 线程池 实际工作函数，调用http::conn对象函数处理
+    bool take(T *&request);               // 取任务：先自旋，再休眠等待。取到任务返回真
+    bool take_local(int id, T *&request); // 工作窃取模式取任务：先本地队列，再窃取其他线程
+    bool steal(int id, T *&request);      // 依次尝试 本地队列 和 其他线程的队列
+    void wake_peer(int id);               // 唤醒一个 正在休眠的其他线程 前来窃取
 
 public:
-    threadpool(int thread_size = 8, int max_requsts = 10000); // 构造函数， 默认构造
-    ~threadpool();                                            // 析构函数
-    bool append(T *request);                                  // 添加任务
+    // 构造函数， 默认构造。mode 为调度模式
+    threadpool(int thread_size = 8, int max_requsts = 10000, int mode = POOL_SHARED);
+    ~threadpool(); // 析构函数
+    // 添加任务。key >= 0 时 (如连接 fd) 同一 key 的任务分发到同一线程，保持缓存局部性
+    bool append(T *request, int key = -1);
 };
 
 // 构造函数， 默认构造
 template <typename T>
-threadpool<T>::threadpool(int thread_size, int max_requsts)
+threadpool<T>::threadpool(int thread_size, int max_requsts, int mode)
+    : m_workqueue(mode == POOL_SHARED && max_requsts > 0 ? max_requsts : 1) // 最多 max_requsts 个等待处理的请求
 {
     m_thread_size = thread_size;
     m_max_requests = max_requsts;
+    m_mode = mode;
     m_stop = false;
     m_threads = NULL;
+    m_local = NULL;
+    m_localstat = NULL;
+    m_parked = NULL;
+    m_nparked = 0;
+    m_rr = 0;
+    m_worker_id = 0;
 
     // 传入线程数量或最大请求数量 非法
     if (thread_size <= 0 || max_requsts <= 0)
@@ -48,6 +82,23 @@ threadpool<T>::threadpool(int thread_size, int max_requsts)
         throw std::exception(); // 抛出异常
     }
 
+    // 工作窃取模式：最大请求数量平均分配到 每个线程的本地队列
+    if (m_mode == POOL_STEALING)
+    {
+        int local_size = (max_requsts + thread_size - 1) / thread_size;
+        m_local = new ring_queue<T *> *[m_thread_size];
+        for (int i = 0; i < m_thread_size; ++i)
+        {
+            m_local[i] = new ring_queue<T *>(local_size);
+        }
+        m_localstat = new event_count[m_thread_size];
+        m_parked = new std::atomic<bool>[m_thread_size];
+        for (int i = 0; i < m_thread_size; ++i)
+        {
+            m_parked[i] = false;
+        }
+    }
+
     m_threads = new pthread_t[m_thread_size]; // 申请线程池空间
 
     if (m_threads == NULL)
@@ -83,25 +134,46 @@ threadpool<T>::~threadpool()
     }
     m_threads = NULL;
     m_stop = true;
+    m_queuestat.notify_all(); // 唤醒所有休眠线程，令其退出
+    for (int i = 0; m_localstat && i < m_thread_size; ++i)
+    {
+        m_localstat[i].notify_all();
+    }
+    // 工作线程已分离，本地队列不释放，避免线程退出前访问已释放的队列
 }
 
-// 添加任务到请求队列。 请求队列 做为 互斥资源 访问
+// 添加任务到请求队列。 请求队列为无锁队列，只有存在休眠线程时才产生唤醒系统调用
 template <typename T>
-bool threadpool<T>::append(T *request)
+bool threadpool<T>::append(T *request, int key)
 {
-    // 先加锁，然后判断是否 还有空余位置 添加队列
-    m_queuelocker.lock();
-    if (m_workqueue.size() >= m_max_requests)
-    {
-        // 超出最大容量，返回失败
-        m_queuelocker.unlock();
-        return false;
-    }
-    // 加入 任务队列
-    m_workqueue.push_back(request);
-    m_queuelocker.unlock(); // 解锁
-    m_queuestat.post();     // 信号量更新，有新任务需要处理
-    return true;
+    if (m_mode == POOL_SHARED)
+    {
+        // 加入 任务队列，超出最大容量，返回失败
+        if (!m_workqueue.push(request))
+        {
+            return false;
+        }
+        m_queuestat.notify_one(); // 有新任务需要处理，唤醒一个休眠线程
+        return true;
+    }
+
+    // 工作窃取模式：按 key 哈希 或 轮询 选择目标线程，目标队列满则顺延到下一个线程
+    int target = (key >= 0) ? key % m_thread_size : (int)(m_rr++ % m_thread_size);
+    for (int i = 0; i < m_thread_size; ++i)
+    {
+        int idx = (target + i) % m_thread_size;
+        if (m_local[idx]->push(request))
+        {
+            m_localstat[idx].notify_one(); // 唤醒目标线程
+            // 目标线程正在处理其他任务：唤醒一个休眠的线程 前来窃取，新任务不必等待目标线程
+            if (!m_parked[idx].load() && m_nparked.load() > 0)
+            {
+                wake_peer(idx);
+            }
+            return true;
+        }
+    }
+    return false; // 所有队列都已满
 }
 
 // 每个线程都会执行 worker, 然后调用 run 一直运行。没有任务的时候处于阻塞状态
@@ -115,23 +187,98 @@ void *threadpool<T>::worker(void *arg)
     return pool;
 }
 
+// 取任务：先自旋尝试 SPIN_COUNT 次，仍无任务则休眠在事件计数器上
+template <typename T>
+bool threadpool<T>::take(T *&request)
+{
+    for (int i = 0; i < SPIN_COUNT; ++i)
+    {
+        if (m_workqueue.pop(request))
+        {
+            return true;
+        }
+    }
+
+    // 登记休眠之后 再检查一次队列，避免错过 登记之前 到来的任务
+    int key = m_queuestat.prepare_wait();
+    if (m_workqueue.pop(request) || m_stop)
+    {
+        m_queuestat.cancel_wait();
+        return !m_stop;
+    }
+    m_queuestat.wait(key); // 等待队列 有任务到来 (阻塞)
+    return false;
+}
+
+// 依次尝试 本地队列 和 其他线程的队列 (从相邻线程开始，分散窃取的目标)
+template <typename T>
+bool threadpool<T>::steal(int id, T *&request)
+{
+    for (int i = 0; i < m_thread_size; ++i)
+    {
+        if (m_local[(id + i) % m_thread_size]->pop(request))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 唤醒 id 之后第一个正在休眠的线程
+template <typename T>
+void threadpool<T>::wake_peer(int id)
+{
+    for (int i = 1; i < m_thread_size; ++i)
+    {
+        int peer = (id + i) % m_thread_size;
+        if (m_parked[peer].load())
+        {
+            m_localstat[peer].notify_one();
+            return;
+        }
+    }
+}
+
+// 工作窃取模式取任务：先自旋，再休眠在 本线程的事件计数器上
+template <typename T>
+bool threadpool<T>::take_local(int id, T *&request)
+{
+    for (int i = 0; i < SPIN_COUNT; ++i)
+    {
+        if (steal(id, request))
+        {
+            return true;
+        }
+    }
+
+    // 登记休眠 先于 再次检查队列：入队方之后读到的休眠标记 一定包含本线程
+    int key = m_localstat[id].prepare_wait();
+    m_parked[id] = true;
+    ++m_nparked;
+    bool found = steal(id, request) || m_stop;
+    if (!found)
+    {
+        m_localstat[id].wait(key);
+    }
+    else
+    {
+        m_localstat[id].cancel_wait();
+    }
+    m_parked[id] = false;
+    --m_nparked;
+    return found && !m_stop;
+}
+
 template <typename T>
 void threadpool<T>::run()
 {
+    int id = m_worker_id++; // 本线程编号，对应本地队列下标
     // 循环取任务执行, 直到stop
     while (!m_stop)
     {
-        m_queuestat.wait();      // 等待队列 有任务到来 (阻塞)
-        m_queuelocker.lock();    // 上锁，操作任务队列
-        if (m_workqueue.empty()) // 如果当前任务队列不存在任务，则继续循环
-        {
-            m_queuelocker.unlock(); // 解锁处理
-            continue;
-        }
-        T *request = m_workqueue.front(); // 读取任务
-        m_workqueue.pop_front();          // 从任务队列删除任务
-        m_queuelocker.unlock();           // 解锁处理
-        if (request == NULL)              // 获取任务失败，继续循环
+        T *request = NULL;
+        bool ok = (m_mode == POOL_SHARED) ? take(request) : take_local(id, request);
+        if (!ok || request == NULL) // 获取任务失败，继续循环
         {
             continue;
         }
@@ -0,0 +1,119 @@
+/*
+二进制日志 解码工具：把 LOG_BINARY 模式写入的日志文件 转换为与文本模式相同的日志行，输出到标准输出
+
+    文件以 LOG_MAGIC 开头，之后是 定义记录 与 数据记录；同一文件被多次启动的服务器追加写入时，
+    后写入的定义 覆盖同编号的旧定义 (每次启动 编号重新分配，定义总在使用之前写入)
+
+    压缩后的文件 (.bin.gz) 可以直接解码
+
+    编译运行： make tools && ./bin/log_decode 2026_01_01_.ServerLog.bin [...]
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "../log_format.h"
+
+#define LINE_SIZE 8192 // 一行的最大长度
+
+// 一个格式定义
+struct def_entry
+{
+    int level;
+    std::string sig;
+    std::string format;
+};
+
+// 解码一个文件，成功返回真
+static bool decode(const char *path)
+{
+    gzFile fp = gzopen(path, "rb"); // 未压缩的文件 按原样读取
+    if (fp == NULL)
+    {
+        perror(path);
+        return false;
+    }
+    std::vector<char> data;
+    char chunk[1 << 16];
+    int n;
+    while ((n = gzread(fp, chunk, sizeof(chunk))) > 0)
+    {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    gzclose(fp);
+    if (data.size() < LOG_MAGIC_SIZE || memcmp(data.data(), LOG_MAGIC, LOG_MAGIC_SIZE) != 0)
+    {
+        fprintf(stderr, "%s: not a binary log file\n", path);
+        return false;
+    }
+
+    std::vector<def_entry> defs;
+    log_clock clock;
+    char line[LINE_SIZE];
+    size_t off = LOG_MAGIC_SIZE;
+    while (off + sizeof(log_record) <= data.size())
+    {
+        log_record r;
+        memcpy(&r, data.data() + off, sizeof(r));
+        if (r.size < sizeof(r) || off + r.size > data.size())
+        {
+            fprintf(stderr, "%s: truncated record at offset %zu\n", path, off);
+            return false;
+        }
+        const char *payload = data.data() + off + sizeof(r);
+        size_t len = r.size - sizeof(r);
+        off += r.size;
+
+        if (r.id & LOG_DEF_FLAG)
+        {
+            // 定义记录：级别 + 签名 + '\0' + 格式串 + '\0'
+            uint32_t id = r.id & ~LOG_DEF_FLAG;
+            if (len < 3 || id >= LOG_DEF_MAX)
+            {
+                fprintf(stderr, "%s: bad definition record at offset %zu\n", path, off - r.size);
+                continue;
+            }
+            const char *sig = payload + 1;
+            const char *sig_end = (const char *)memchr(sig, '\0', len - 1);
+            if (sig_end == NULL || memchr(sig_end + 1, '\0', payload + len - sig_end - 1) == NULL)
+            {
+                continue;
+            }
+            if (id >= defs.size())
+            {
+                defs.resize(id + 1);
+            }
+            defs[id].level = payload[0];
+            defs[id].sig = sig;
+            defs[id].format = sig_end + 1;
+            continue;
+        }
+        if (r.id >= defs.size() || defs[r.id].format.empty())
+        {
+            fprintf(stderr, "%s: record with undefined format %u\n", path, r.id);
+            continue;
+        }
+        const def_entry &d = defs[r.id];
+        int m = log_format_record(line, sizeof(line), clock, r, payload, d.level, d.format.c_str(), d.sig.c_str());
+        fwrite(line, 1, m, stdout);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s binary_log_file [...]\n", argv[0]);
+        return 1;
+    }
+    bool ok = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        ok = decode(argv[i]) && ok;
+    }
+    return ok ? 0 : 1;
+}